@@ -134,6 +134,13 @@ std::string ASCII::execute(Utils::CommandParser &parser) {
         } else {
             out << "syntax error : nn-benchmark <integral>";
         }
+    } else if (const auto res = parser.find("uct-benchmark", 0)) {
+        lambda_syntax_not_understood(parser, 2);
+        if (const auto in = parser.get_commands(1)) {
+            out << m_ascii_engine->uct_benchmark(std::stoi(in->str));
+        } else {
+            out << "syntax error : uct-benchmark <integral>";
+        }
     } else {
         out << "unknown command";
     }
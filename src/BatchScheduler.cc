@@ -0,0 +1,259 @@
+#include "BatchScheduler.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cassert>
+
+BatchScheduler::~BatchScheduler() {
+    quit();
+}
+
+void BatchScheduler::initialize(Evaluator evaluator, const int threads,
+                                const int max_batch_size, const int max_wait_us) {
+    quit();
+
+    assert(threads >= 1 && max_batch_size >= 1);
+
+    m_evaluator = evaluator;
+    m_max_batch_size = max_batch_size;
+    m_max_wait_us = std::max(max_wait_us, 0);
+
+    // Guess the interval until the first requests come.
+    m_interval_us = m_max_wait_us / 4.0f;
+    m_forward_us.store(m_max_wait_us);
+
+    m_histogram = std::make_unique<std::atomic<std::uint64_t>[]>(m_max_batch_size + 1);
+    for (auto b = size_t{0}; b <= m_max_batch_size; ++b) {
+        m_histogram[b].store(0);
+    }
+    m_depth_sum.store(0);
+    m_depth_max.store(0);
+
+    m_running.store(true);
+    for (int t = 0; t < threads; ++t) {
+        m_threads.emplace_back([this](){ worker(); });
+    }
+}
+
+void BatchScheduler::quit() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_running.store(false);
+    }
+    m_sleep_cv.notify_all();
+    for (auto &t : m_threads) {
+        t.join();
+    }
+    m_threads.clear();
+}
+
+bool BatchScheduler::running() const {
+    return m_running.load();
+}
+
+void BatchScheduler::evaluate(Request *const *requests, const size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    // Link the requests into one chain, so they are pushed at once.
+    for (auto i = size_t{1}; i < size; ++i) {
+        requests[i]->next = requests[i-1];
+    }
+    for (auto i = size_t{0}; i < size; ++i) {
+        requests[i]->done.store(false, std::memory_order_relaxed);
+    }
+    m_producers.fetch_add(1);
+
+    auto first = requests[0];
+    auto last = requests[size-1];
+    first->next = m_pushed.load(std::memory_order_relaxed);
+    while (!m_pushed.compare_exchange_weak(first->next, last)) {}
+    m_queue_depth.fetch_add(size, std::memory_order_relaxed);
+
+    // The evaluator sleeps only after it saw no pushed request, so either
+    // it sees these ones or it is woken up here.
+    if (m_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_sleep_cv.notify_one();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_done_mutex);
+        m_done_cv.wait(lock, [requests, size](){
+            return std::all_of(requests, requests + size,
+                               [](const Request *r){
+                                   return r->done.load(std::memory_order_acquire);
+                               });
+        });
+    }
+    m_producers.fetch_sub(1);
+}
+
+size_t BatchScheduler::take_pushed() {
+    auto head = m_pushed.exchange(nullptr, std::memory_order_acquire);
+    if (head == nullptr) {
+        return 0;
+    }
+
+    // Reverse the pushed requests, and append them to the pending ones.
+    auto size = size_t{0};
+    auto tail = head;
+    auto reversed = static_cast<Request *>(nullptr);
+    while (head != nullptr) {
+        auto next = head->next;
+        head->next = reversed;
+        reversed = head;
+        head = next;
+        size++;
+    }
+
+    if (m_pending_tail != nullptr) {
+        m_pending_tail->next = reversed;
+    } else {
+        m_pending_head = reversed;
+    }
+    m_pending_tail = tail;
+    return size;
+}
+
+bool BatchScheduler::wait_pushed(const std::chrono::microseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_sleep_mutex);
+    m_sleeping.fetch_add(1);
+    const auto pushed = m_sleep_cv.wait_for(lock, timeout, [this](){
+        return m_pushed.load() != nullptr || !m_running.load();
+    });
+    m_sleeping.fetch_sub(1);
+    return pushed && m_pushed.load() != nullptr;
+}
+
+void BatchScheduler::gather_batch(std::vector<Request *> &batch) {
+    batch.clear();
+
+    const auto fill = [this, &batch](){
+        while (batch.size() < m_max_batch_size && m_pending_head != nullptr) {
+            batch.emplace_back(m_pending_head);
+            m_pending_head = m_pending_head->next;
+        }
+        if (m_pending_head == nullptr) {
+            m_pending_tail = nullptr;
+        }
+    };
+
+    take_pushed();
+    fill();
+
+    while (batch.empty()) {
+        if (!m_running.load() && m_pushed.load() == nullptr) {
+            return;
+        }
+        wait_pushed(std::chrono::milliseconds(100));
+        take_pushed();
+        fill();
+    }
+
+    while (batch.size() < m_max_batch_size && m_running.load()) {
+        // If all producers have pushed, no more request comes until
+        // this batch is done.
+        const auto producers = m_producers.load();
+        if (producers > m_producers_peak.load(std::memory_order_relaxed)) {
+            m_producers_peak.store(producers, std::memory_order_relaxed);
+        }
+        if (producers >= m_producers_peak.load(std::memory_order_relaxed)) {
+            break;
+        }
+
+        // Wait for about two intervals. Waiting longer than one forward
+        // costs more than forwarding the rest in the next batch.
+        const auto timeout_us = std::min({2.0f * m_interval_us,
+                                          m_forward_us.load(std::memory_order_relaxed),
+                                          m_max_wait_us});
+        const auto start = Clock::now();
+        if (!wait_pushed(std::chrono::microseconds(static_cast<int>(timeout_us)))) {
+            // The requests come slower than expected.
+            m_interval_us = 0.75f * m_interval_us + 0.25f * timeout_us;
+            break;
+        }
+        const auto elapsed = std::chrono::duration<float, std::micro>(Clock::now() - start);
+        const auto arrived = take_pushed();
+        if (arrived > 0) {
+            const auto sample = std::min(elapsed.count() / arrived, m_max_wait_us);
+            m_interval_us = 0.75f * m_interval_us + 0.25f * sample;
+        }
+        fill();
+    }
+
+    const auto depth = m_queue_depth.fetch_sub(batch.size(), std::memory_order_relaxed);
+    m_histogram[batch.size()].fetch_add(1, std::memory_order_relaxed);
+    m_depth_sum.fetch_add(depth, std::memory_order_relaxed);
+    if (depth > m_depth_max.load(std::memory_order_relaxed)) {
+        m_depth_max.store(depth, std::memory_order_relaxed);
+    }
+}
+
+void BatchScheduler::worker() {
+    auto batch = std::vector<Request *>{};
+    batch.reserve(m_max_batch_size);
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(m_gather_mutex);
+            gather_batch(batch);
+        }
+        if (batch.empty()) {
+            return;
+        }
+
+        const auto start = Clock::now();
+        m_evaluator(batch);
+        const auto elapsed = std::chrono::duration<float, std::micro>(Clock::now() - start);
+        m_forward_us.store(0.75f * m_forward_us.load(std::memory_order_relaxed) +
+                               0.25f * elapsed.count(),
+                           std::memory_order_relaxed);
+
+        // The producer may release the request once it is done.
+        for (auto r : batch) {
+            r->done.store(true, std::memory_order_release);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_done_mutex);
+        }
+        m_done_cv.notify_all();
+    }
+}
+
+void BatchScheduler::dump_stats() {
+    if (m_histogram == nullptr) {
+        return;
+    }
+
+    auto histogram = std::vector<std::uint64_t>(m_max_batch_size + 1);
+    auto batches = std::uint64_t{0};
+    auto evals = std::uint64_t{0};
+    for (auto b = size_t{1}; b <= m_max_batch_size; ++b) {
+        histogram[b] = m_histogram[b].exchange(0);
+        batches += histogram[b];
+        evals += b * histogram[b];
+    }
+    const auto depth_sum = m_depth_sum.exchange(0);
+    const auto depth_max = m_depth_max.exchange(0);
+
+    // The number of the search threads may change before the next dump.
+    m_producers_peak.store(0, std::memory_order_relaxed);
+    if (batches == 0) {
+        return;
+    }
+
+    Utils::auto_printf("Batches :\n");
+    Utils::auto_printf(" batches : %llu\n", static_cast<unsigned long long>(batches));
+    Utils::auto_printf(" average size : %.2f\n", static_cast<float>(evals) / batches);
+    Utils::auto_printf(" queue depth : %.2f (average), %d (max)\n",
+                       static_cast<float>(depth_sum) / batches, depth_max);
+    Utils::auto_printf(" sizes :");
+    for (auto b = size_t{1}; b <= m_max_batch_size; ++b) {
+        if (histogram[b] > 0) {
+            Utils::auto_printf(" %zu:%llu", b, static_cast<unsigned long long>(histogram[b]));
+        }
+    }
+    Utils::auto_printf("\n");
+}
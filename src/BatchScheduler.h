@@ -0,0 +1,118 @@
+#ifndef BATCHSCHEDULER_H_INCLUDE
+#define BATCHSCHEDULER_H_INCLUDE
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Cache.h"
+#include "GameState.h"
+
+/*
+ * The scheduler collects the evaluation requests of all search threads
+ * and forwards them in batches. The producers push the requests without
+ * locking. The evaluator threads take turns to form a batch, and forward
+ * it without holding any lock, so one evaluator forms the next batch while
+ * another one is forwarding.
+ *
+ * An evaluator waits for more requests only if some producers have not
+ * pushed yet, and only as long as the next request is expected to come.
+ * The expected interval is learned from the observed arrivals. The wait
+ * never exceeds the time of one forward nor the max wait time.
+ */
+class BatchScheduler {
+public:
+    struct Request {
+        const Position *state{nullptr};
+        int symmetry{0};
+        NNResult result;
+
+        Request *next{nullptr};
+        std::atomic<bool> done{false};
+    };
+
+    // Evaluate the batch and fill the results of the requests.
+    using Evaluator = std::function<void(const std::vector<Request *> &)>;
+
+    BatchScheduler() = default;
+    ~BatchScheduler();
+
+    BatchScheduler(const BatchScheduler&) = delete;
+    BatchScheduler& operator=(const BatchScheduler&) = delete;
+
+    void initialize(Evaluator evaluator, const int threads,
+                    const int max_batch_size, const int max_wait_us);
+
+    void quit();
+
+    bool running() const;
+
+    // Push the requests and wait until all of them are evaluated.
+    void evaluate(Request *const *requests, const size_t size);
+
+    // Print the queue depth and the batch size histogram since the last
+    // dump, and clear them.
+    void dump_stats();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void push(Request *request);
+
+    // Move the pushed requests into the pending list in FIFO order.
+    // Return the number of the new requests.
+    size_t take_pushed();
+
+    // Wait for the new requests. Return false if none came.
+    bool wait_pushed(const std::chrono::microseconds timeout);
+
+    void gather_batch(std::vector<Request *> &batch);
+
+    void worker();
+
+    Evaluator m_evaluator;
+
+    std::vector<std::thread> m_threads;
+    std::atomic<bool> m_running{false};
+    size_t m_max_batch_size{1};
+    float m_max_wait_us{0.0f};
+
+    // The pushed requests in LIFO order.
+    std::atomic<Request *> m_pushed{nullptr};
+    std::atomic<int> m_queue_depth{0};
+
+    // The evaluators sleeping in wait_pushed().
+    std::atomic<int> m_sleeping{0};
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_sleep_cv;
+
+    // The producers waiting for the results.
+    std::mutex m_done_mutex;
+    std::condition_variable m_done_cv;
+
+    // The producers in evaluate() now, and the most of them seen since
+    // the last dump.
+    std::atomic<int> m_producers{0};
+    std::atomic<int> m_producers_peak{0};
+
+    std::atomic<float> m_forward_us{0.0f};
+
+    // Only the evaluator forming the batch owns them. The pending
+    // requests are linked in FIFO order.
+    std::mutex m_gather_mutex;
+    Request *m_pending_head{nullptr};
+    Request *m_pending_tail{nullptr};
+    float m_interval_us{0.0f};
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> m_histogram{nullptr};
+    std::atomic<std::uint64_t> m_depth_sum{0};
+    std::atomic<int> m_depth_max{0};
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef BITBOARD_H_INCLUDE
+#define BITBOARD_H_INCLUDE
+
+#include <cstdint>
+
+#include "config.h"
+
+static_assert(BOARD_SIZE <= 8, "The bitboard only supports the board size up to 8x8!\n");
+
+/*
+ * A bitboard is one 64-bits mask. The square (x, y) is stored
+ * at bit (y * BITBOARD_WIDTH + x). The stride is fixed, so a smaller
+ * board only uses the upper-left corner of the mask.
+ */
+namespace Bitboard {
+
+using MASK = std::uint64_t;
+
+static constexpr int BITBOARD_WIDTH = 8;
+
+static constexpr int NUM_BITS = BITBOARD_WIDTH * BITBOARD_WIDTH;
+
+static constexpr MASK NOT_FILE_A = 0xfefefefefefefefeULL;
+
+static constexpr MASK NOT_FILE_H = 0x7f7f7f7f7f7f7f7fULL;
+
+inline MASK square(const int bit) {
+    return MASK{1ULL} << bit;
+}
+
+inline int count(const MASK m) {
+    return __builtin_popcountll(m);
+}
+
+inline int lowest(const MASK m) {
+    return __builtin_ctzll(m);
+}
+
+inline MASK pop_lowest(const MASK m) {
+    return m & (m - 1);
+}
+
+// All squares of the (boardsize x boardsize) board.
+inline MASK board_mask(const int boardsize) {
+    auto res = MASK{0ULL};
+    for (int y = 0; y < boardsize; ++y) {
+        for (int x = 0; x < boardsize; ++x) {
+            res |= square(y * BITBOARD_WIDTH + x);
+        }
+    }
+    return res;
+}
+
+// Shift every disc one step to the direction. The discs which
+// go out of the board are dropped.
+template<int DIR>
+inline MASK shift(const MASK m) {
+    static_assert(DIR >= 0 && DIR < 8, "Unknown direction!\n");
+    switch (DIR) {
+        case 0: return m >> 8;                // north
+        case 1: return (m >> 1) & NOT_FILE_H; // west
+        case 2: return (m << 1) & NOT_FILE_A; // east
+        case 3: return m << 8;                // south
+        case 4: return (m >> 9) & NOT_FILE_H; // north-west
+        case 5: return (m >> 7) & NOT_FILE_A; // north-east
+        case 6: return (m << 7) & NOT_FILE_H; // south-west
+        case 7: return (m << 9) & NOT_FILE_A; // south-east
+    }
+    return 0ULL;
+}
+
+template<int DIR>
+inline MASK moves_dir(const MASK player, const MASK opponent) {
+    auto x = shift<DIR>(player) & opponent;
+    x |= shift<DIR>(x) & opponent;
+    x |= shift<DIR>(x) & opponent;
+    x |= shift<DIR>(x) & opponent;
+    x |= shift<DIR>(x) & opponent;
+    x |= shift<DIR>(x) & opponent;
+    return shift<DIR>(x);
+}
+
+template<int DIR>
+inline MASK flips_dir(const MASK move, const MASK player, const MASK opponent) {
+    auto res = MASK{0ULL};
+    auto x = shift<DIR>(move);
+    while (x & opponent) {
+        res |= x;
+        x = shift<DIR>(x);
+    }
+    return (x & player) ? res : MASK{0ULL};
+}
+
+// The legal moves of player. The result is not masked by the board
+// size, the caller should do it if the board is smaller than 8x8.
+inline MASK get_moves(const MASK player, const MASK opponent) {
+    const auto empty = ~(player | opponent);
+    auto res = MASK{0ULL};
+    res |= moves_dir<0>(player, opponent);
+    res |= moves_dir<1>(player, opponent);
+    res |= moves_dir<2>(player, opponent);
+    res |= moves_dir<3>(player, opponent);
+    res |= moves_dir<4>(player, opponent);
+    res |= moves_dir<5>(player, opponent);
+    res |= moves_dir<6>(player, opponent);
+    res |= moves_dir<7>(player, opponent);
+    return res & empty;
+}
+
+// The opponent discs flipped by playing on the bit. Empty
+// result means the move is illegal.
+inline MASK get_flips(const int bit, const MASK player, const MASK opponent) {
+    const auto move = square(bit);
+    auto res = MASK{0ULL};
+    res |= flips_dir<0>(move, player, opponent);
+    res |= flips_dir<1>(move, player, opponent);
+    res |= flips_dir<2>(move, player, opponent);
+    res |= flips_dir<3>(move, player, opponent);
+    res |= flips_dir<4>(move, player, opponent);
+    res |= flips_dir<5>(move, player, opponent);
+    res |= flips_dir<6>(move, player, opponent);
+    res |= flips_dir<7>(move, player, opponent);
+    return res;
+}
+
+} // namespace Bitboard
+
+#endif
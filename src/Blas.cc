@@ -302,27 +302,27 @@ void FullyConnect::Forward(const int input_size,
                            const std::vector<float> &input,
                            const std::vector<float> &weights,
                            const std::vector<float> &biases,
-                           std::vector<float> &output, bool ReLU) {
+                           std::vector<float> &output, bool ReLU,
+                           const int batch_size) {
 
     const auto lambda_ReLU = [](const auto val) -> float {
         return (val > 0.0f) ? val : 0.0f;
     };
 
-    static constexpr int batch = 1;
     Blas::dense(input_size,
                 output_size,
-                batch, 
+                batch_size,
                 input.data(),
                 weights.data(),
                 output.data());
 
     if (ReLU) {
-        for (auto o = int{0}; o < output_size; ++o) {
-            output[o] = lambda_ReLU(biases[o] + output[o]);
+        for (auto o = int{0}; o < batch_size * output_size; ++o) {
+            output[o] = lambda_ReLU(biases[o % output_size] + output[o]);
         }
     } else {
-        for (auto o = int{0}; o < output_size; ++o) {
-            output[o] = biases[o] + output[o];
+        for (auto o = int{0}; o < batch_size * output_size; ++o) {
+            output[o] = biases[o % output_size] + output[o];
         }
     }
 }
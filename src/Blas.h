@@ -64,6 +64,11 @@ public:
 
 };
 
+// The batched layers take the positions one after another, [batch][C][H][W].
+// The buffers may be larger than the batch needs.
+
+// The features are the biases of the input convolution, one set for each
+// position. They are added in the epilogue of the convolution.
 template<int CONV_SIZE>
 class InputPool {
 public:
@@ -73,7 +78,9 @@ public:
                         const std::vector<float> &input,
                         const std::vector<float> &weights_w,
                         const std::vector<float> &weights_b,
-                        std::vector<float> &output);
+                        const std::vector<float> &conv_biases,
+                        std::vector<float> &output,
+                        const size_t batch_size = 1);
 
 private:
     static constexpr auto width = CONV_SIZE;
@@ -109,13 +116,18 @@ public:
                         const std::vector<float> &weights_w1,
                         const std::vector<float> &weights_b1,
                         const std::vector<float> &weights_w2,
-                        const std::vector<float> &weights_b2);
+                        const std::vector<float> &weights_b2,
+                        std::vector<float> &pool,
+                        std::vector<float> &fc_out,
+                        std::vector<float> &scale,
+                        const size_t batch_size = 1);
 
 private:
     static void SEProcess(const size_t channels,
                           std::vector<float> &input,
                           const std::vector<float> &residual,
-                          const std::vector<float> &scale);
+                          const std::vector<float> &scale,
+                          const size_t batch_size);
 
     static constexpr auto width = CONV_SIZE;
     static constexpr auto height = CONV_SIZE;
@@ -140,29 +152,16 @@ template<int CONV_SIZE>
 class Convolve1 {
 public:
     Convolve1() = delete;
+    // The biases and the ReLU are applied to each position right after
+    // its GEMM, while the output is still in the cache.
     static void Forward(const size_t input_channels,
                         const size_t output_channels,
                         const std::vector<float> &input,
                         const std::vector<float> &weights,
-                        std::vector<float> &output);
-
-private:
-    static constexpr auto width = CONV_SIZE;
-    static constexpr auto height = CONV_SIZE;
-    static constexpr auto spatial_size = width * height;
-};
-
-
-template<int CONV_SIZE>
-class Batchnorm {
-public:
-    Batchnorm() = delete;
-    static void Forward(const size_t channels,
-                        std::vector<float> &input,
-                        const std::vector<float> &means,
-                        const std::vector<float> &stddevs,
-                        const float *const eltwise = nullptr,
-                        const bool ReLU = true);
+                        std::vector<float> &output,
+                        const size_t batch_size = 1,
+                        const float *const biases = nullptr,
+                        const bool ReLU = false);
 
 private:
     static constexpr auto width = CONV_SIZE;
@@ -181,24 +180,40 @@ public:
                         const std::vector<float> &U,
                         std::vector<float> &V,
                         std::vector<float> &M,
-                        std::vector<float> &output);
+                        std::vector<float> &output,
+                        const size_t batch_size = 1,
+                        const float *const biases = nullptr,
+                        const size_t biases_stride = 0,
+                        const bool ReLU = false);
 
     static std::pair<size_t, size_t> get_workspace_size(const size_t input_channels,
-                                                        const size_t output_channels);
+                                                        const size_t output_channels,
+                                                        const size_t batch_size = 1);
 private:
+    // The tiles of all positions are side by side in V and M, so the
+    // batch is in the N dimension of the GEMM.
     static void transform_in(const std::vector<float> &in,
                              std::vector<float> &V,
-                             const int C);
+                             const int C,
+                             const int batch_size);
 
     static void sgemm(const std::vector<float> &U,
                       const std::vector<float> &V,
                       std::vector<float> &M,
                       const int C,
-                      const int K);
+                      const int K,
+                      const int batch_size);
 
+    // The epilogue adds the biases and applies the ReLU while it writes
+    // the output. The biases of the position b begin at b * biases_stride,
+    // so a stride of 0 shares them with all positions.
     static void transform_out(const std::vector<float> &M,
                               std::vector<float> &Y,
-                              const int K);
+                              const int K,
+                              const int batch_size,
+                              const float *const biases,
+                              const size_t biases_stride,
+                              const bool ReLU);
     static constexpr auto WINOGRAD_WTILES = (CONV_SIZE / WINOGRAD_M + (CONV_SIZE % WINOGRAD_M != 0));
     static constexpr auto WTILES = WINOGRAD_WTILES;
     static constexpr auto WINOGRAD_P = WINOGRAD_WTILES * WINOGRAD_WTILES;
@@ -242,7 +257,8 @@ public:
                         const std::vector<float> &input,
                         const std::vector<float> &weights,
                         const std::vector<float> &biases,
-                        std::vector<float> &output, bool ReLU);
+                        std::vector<float> &output, bool ReLU,
+                        const int batch_size = 1);
 
     static std::vector<float> innerproduct(const int inputs_size,
                                            const int outputs_size,
@@ -254,9 +270,11 @@ public:
 
 template<int CONV_SIZE>
 void winograd_convolve3<CONV_SIZE>::transform_in(const std::vector<float> &in,
-                                                 std::vector<float> &V, const int C) {
+                                                 std::vector<float> &V, const int C,
+                                                 const int batch_size) {
 
     constexpr int P = WINOGRAD_P;
+    const int BP = batch_size * P;
     constexpr int Wpad = 2 + WINOGRAD_M * WTILES;
     constexpr int buffersize = 32;
 
@@ -293,39 +311,42 @@ void winograd_convolve3<CONV_SIZE>::transform_in(const std::vector<float> &in,
         o5 = i1 + i3 * (-5.0f / 2.0f) + i5;
     };
 
+    // The positions are inside the channel loop, so the tiles written
+    // to V are contiguous.
     for (auto ch = 0; ch < C; ch++) {
-        for (auto yin = 0; yin < H; yin++) {
-            for (auto xin = 0; xin < W; xin++) {
-                in_pad[yin + 1][xin + 1] = in[ch * (W * H) + yin * W + xin];
+        for (auto batch = 0; batch < batch_size; batch++) {
+            for (auto yin = 0; yin < H; yin++) {
+                for (auto xin = 0; xin < W; xin++) {
+                    in_pad[yin + 1][xin + 1] = in[(batch * C + ch) * (W * H) + yin * W + xin];
+                }
             }
-        }
-        for (auto block_y = 0; block_y < WTILES; block_y++) {
-            // Tiles overlap by 2
-            const auto yin = WINOGRAD_M * block_y;
-            for (auto block_x = 0; block_x < WTILES; block_x++) {
-                const auto xin = WINOGRAD_M * block_x;
+            for (auto block_y = 0; block_y < WTILES; block_y++) {
+                // Tiles overlap by 2
+                const auto yin = WINOGRAD_M * block_y;
+                for (auto block_x = 0; block_x < WTILES; block_x++) {
+                    const auto xin = WINOGRAD_M * block_x;
 #define DECL_T1(XX)                                                            \
   float T1_##XX##_0, T1_##XX##_1, T1_##XX##_2, T1_##XX##_3, T1_##XX##_4,       \
       T1_##XX##_5;
-                DECL_T1(0)
-                DECL_T1(1)
-                DECL_T1(2)
-                DECL_T1(3)
-                DECL_T1(4)
-                DECL_T1(5)
-
-              // Calculates transpose(B).x.B
+                    DECL_T1(0)
+                    DECL_T1(1)
+                    DECL_T1(2)
+                    DECL_T1(3)
+                    DECL_T1(4)
+                    DECL_T1(5)
+
+                  // Calculates transpose(B).x.B
 #define MULTIPLY_BT(XX)                                                        \
   multiply_bt(T1_0_##XX, T1_1_##XX, T1_2_##XX, T1_3_##XX, T1_4_##XX,           \
               T1_5_##XX, in_pad[yin + 0][xin + XX], in_pad[yin + 1][xin + XX], \
               in_pad[yin + 2][xin + XX], in_pad[yin + 3][xin + XX],            \
               in_pad[yin + 4][xin + XX], in_pad[yin + 5][xin + XX]);
-                MULTIPLY_BT(0)
-                MULTIPLY_BT(1)
-                MULTIPLY_BT(2)
-                MULTIPLY_BT(3)
-                MULTIPLY_BT(4)
-                MULTIPLY_BT(5)
+                    MULTIPLY_BT(0)
+                    MULTIPLY_BT(1)
+                    MULTIPLY_BT(2)
+                    MULTIPLY_BT(3)
+                    MULTIPLY_BT(4)
+                    MULTIPLY_BT(5)
 
 #define MULTIPLY_B(XX)                                                         \
   multiply_bt(buffer[buffersize * (XX * WINOGRAD_ALPHA + 0) + buffer_entries], \
@@ -336,28 +357,30 @@ void winograd_convolve3<CONV_SIZE>::transform_in(const std::vector<float> &in,
               buffer[buffersize * (XX * WINOGRAD_ALPHA + 5) + buffer_entries], \
               T1_##XX##_0, T1_##XX##_1, T1_##XX##_2, T1_##XX##_3, T1_##XX##_4, \
               T1_##XX##_5);
-                MULTIPLY_B(0)
-                MULTIPLY_B(1)
-                MULTIPLY_B(2)
-                MULTIPLY_B(3)
-                MULTIPLY_B(4)
-                MULTIPLY_B(5)
-
-                if (buffer_entries == 0) {
-                    buffer_offset = ch * P + block_y * WTILES + block_x;
-                }
-                buffer_entries++;
+                    MULTIPLY_B(0)
+                    MULTIPLY_B(1)
+                    MULTIPLY_B(2)
+                    MULTIPLY_B(3)
+                    MULTIPLY_B(4)
+                    MULTIPLY_B(5)
+
+                    if (buffer_entries == 0) {
+                        buffer_offset = ch * BP + batch * P + block_y * WTILES + block_x;
+                    }
+                    buffer_entries++;
 
-                if (buffer_entries >= buffersize ||
-                    (ch == C - 1 && block_x == WTILES - 1 && block_y == WTILES - 1)) {
+                    if (buffer_entries >= buffersize ||
+                        (ch == C - 1 && batch == batch_size - 1 &&
+                             block_x == WTILES - 1 && block_y == WTILES - 1)) {
 
-                    for (auto i = 0; i < WINOGRAD_ALPHA * WINOGRAD_ALPHA; i++) {
-                        for (auto entry = 0; entry < buffer_entries; entry++) {
-                            V[i * C * P + buffer_offset + entry] =
-                                buffer[i * buffersize + entry];
+                        for (auto i = 0; i < WINOGRAD_ALPHA * WINOGRAD_ALPHA; i++) {
+                            for (auto entry = 0; entry < buffer_entries; entry++) {
+                                V[i * C * BP + buffer_offset + entry] =
+                                    buffer[i * buffersize + entry];
+                            }
                         }
+                        buffer_entries = 0;
                     }
-                    buffer_entries = 0;
                 }
             }
         }
@@ -368,35 +391,44 @@ template<int CONV_SIZE>
 void winograd_convolve3<CONV_SIZE>::sgemm(const std::vector<float> &U,
                                           const std::vector<float> &V,
                                           std::vector<float> &M, const int C,
-                                          const int K) {
-    constexpr auto P = WINOGRAD_P;
+                                          const int K, const int batch_size) {
+    const auto BP = batch_size * WINOGRAD_P;
 
     for (int b = 0; b < WINOGRAD_TILE; b++) {
         const int offset_u = b * K * C;
-        const int offset_v = b * C * P;
-        const int offset_m = b * K * P;
+        const int offset_v = b * C * BP;
+        const int offset_m = b * K * BP;
 
         Blas::winograd_gemm(offset_u,
                             offset_v,
                             offset_m,
                             K,
-                            P,
+                            BP,
                             C,
                             1.0f,
                             U.data(),
                             K,
                             V.data(),
-                            P,
+                            BP,
                             0.0f,
                             M.data(),
-                            P);
+                            BP);
     }
 }
 
 template<int CONV_SIZE>
 void winograd_convolve3<CONV_SIZE>::transform_out(const std::vector<float> &M,
-                                                  std::vector<float> &Y, const int K) {
+                                                  std::vector<float> &Y, const int K,
+                                                  const int batch_size,
+                                                  const float *const biases,
+                                                  const size_t biases_stride,
+                                                  const bool ReLU) {
     constexpr auto P = WINOGRAD_P;
+    const auto BP = batch_size * P;
+
+    const auto lambda_ReLU = [&](const auto val) {
+        return (val > 0.0f || (!ReLU)) ? val : 0.0f;
+    };
 
     // multiple vector [i0..i5] by At and produce [o0..o3]
     // const auto At = std::array<float, WINOGRAD_ALPHA * WINOGRAD_M>
@@ -418,42 +450,45 @@ void winograd_convolve3<CONV_SIZE>::transform_out(const std::vector<float> &M,
     };
 
     for (auto k = 0; k < K; k++) {
-        for (auto block_x = 0; block_x < WTILES; block_x++) {
-            const auto x = WINOGRAD_M * block_x;
-            for (auto block_y = 0; block_y < WTILES; block_y++) {
-                const auto y = WINOGRAD_M * block_y;
-
-                const auto b = block_y * WTILES + block_x;
-                using WinogradTile =
-                    std::array<std::array<float, WINOGRAD_ALPHA>, WINOGRAD_ALPHA>;
-
-                auto temp_m = WinogradTile{};
-                for (auto xi = 0; xi < WINOGRAD_ALPHA; xi++) {
-                    for (auto nu = 0; nu < WINOGRAD_ALPHA; nu++) {
-                        temp_m[xi][nu] = M[(xi * WINOGRAD_ALPHA + nu) * K * P + k * P + b];
+        for (auto batch = 0; batch < batch_size; batch++) {
+            const auto bias = biases ? biases[batch * biases_stride + k] : 0.0f;
+            for (auto block_x = 0; block_x < WTILES; block_x++) {
+                const auto x = WINOGRAD_M * block_x;
+                for (auto block_y = 0; block_y < WTILES; block_y++) {
+                    const auto y = WINOGRAD_M * block_y;
+
+                    const auto b = batch * P + block_y * WTILES + block_x;
+                    using WinogradTile =
+                        std::array<std::array<float, WINOGRAD_ALPHA>, WINOGRAD_ALPHA>;
+
+                    auto temp_m = WinogradTile{};
+                    for (auto xi = 0; xi < WINOGRAD_ALPHA; xi++) {
+                        for (auto nu = 0; nu < WINOGRAD_ALPHA; nu++) {
+                            temp_m[xi][nu] = M[(xi * WINOGRAD_ALPHA + nu) * K * BP + k * BP + b];
+                        }
+                    }
+                    auto temp = std::array<std::array<float, WINOGRAD_ALPHA>, WINOGRAD_M>{};
+                    auto o = std::array<std::array<float, WINOGRAD_M>, WINOGRAD_M>{};
+
+                    // Calculates transpose(A).temp_m.A
+                    for (auto j = 0; j < WINOGRAD_ALPHA; j++) {
+                        multiply_at(temp[0][j], temp[1][j], temp[2][j], temp[3][j],
+                                    temp_m[0][j], temp_m[1][j], temp_m[2][j], temp_m[3][j],
+                                    temp_m[4][j], temp_m[5][j]);
                     }
-                }
-                auto temp = std::array<std::array<float, WINOGRAD_ALPHA>, WINOGRAD_M>{};
-                auto o = std::array<std::array<float, WINOGRAD_M>, WINOGRAD_M>{};
-
-                // Calculates transpose(A).temp_m.A
-                for (auto j = 0; j < WINOGRAD_ALPHA; j++) {
-                    multiply_at(temp[0][j], temp[1][j], temp[2][j], temp[3][j],
-                                temp_m[0][j], temp_m[1][j], temp_m[2][j], temp_m[3][j],
-                                temp_m[4][j], temp_m[5][j]);
-                }
 
-                for (auto i = 0; i < WINOGRAD_M; i++) {
-                    multiply_at(o[i][0], o[i][1], o[i][2], o[i][3], temp[i][0],
-                                temp[i][1], temp[i][2], temp[i][3], temp[i][4],
-                                temp[i][5]);
-                }
+                    for (auto i = 0; i < WINOGRAD_M; i++) {
+                        multiply_at(o[i][0], o[i][1], o[i][2], o[i][3], temp[i][0],
+                                    temp[i][1], temp[i][2], temp[i][3], temp[i][4],
+                                    temp[i][5]);
+                    }
 
-                const auto y_ind = k * H * W + y * W + x;
-                for (auto i = 0; i < WINOGRAD_M; i++) {
-                    for (auto j = 0; j < WINOGRAD_M; j++) {
-                        if (y + i < H && x + j < W) {
-                            Y[y_ind + i * W + j] = o[i][j];
+                    const auto y_ind = (batch * K + k) * H * W + y * W + x;
+                    for (auto i = 0; i < WINOGRAD_M; i++) {
+                        for (auto j = 0; j < WINOGRAD_M; j++) {
+                            if (y + i < H && x + j < W) {
+                                Y[y_ind + i * W + j] = lambda_ReLU(o[i][j] + bias);
+                            }
                         }
                     }
                 }
@@ -469,20 +504,26 @@ void winograd_convolve3<CONV_SIZE>::Forward(const size_t input_channels,
                                             const std::vector<float> &U,
                                             std::vector<float> &V,
                                             std::vector<float> &M,
-                                            std::vector<float> &output) {
-
-    transform_in(input, V, input_channels);
-    sgemm(U, V, M, input_channels, output_channels);
-    transform_out(M, output, output_channels);
+                                            std::vector<float> &output,
+                                            const size_t batch_size,
+                                            const float *const biases,
+                                            const size_t biases_stride,
+                                            const bool ReLU) {
+
+    transform_in(input, V, input_channels, batch_size);
+    sgemm(U, V, M, input_channels, output_channels, batch_size);
+    transform_out(M, output, output_channels, batch_size,
+                  biases, biases_stride, ReLU);
 }
 
 
 template<int CONV_SIZE>
 std::pair<size_t, size_t> winograd_convolve3<CONV_SIZE>::get_workspace_size(const size_t input_channels,
-                                                                            const size_t output_channels) {
+                                                                            const size_t output_channels,
+                                                                            const size_t batch_size) {
 
-    auto winograd_V_size = WINOGRAD_TILE * input_channels * WINOGRAD_P;
-    auto winograd_M_size = WINOGRAD_TILE * output_channels * WINOGRAD_P;
+    auto winograd_V_size = WINOGRAD_TILE * input_channels * WINOGRAD_P * batch_size;
+    auto winograd_M_size = WINOGRAD_TILE * output_channels * WINOGRAD_P * batch_size;
     return std::make_pair(winograd_V_size, winograd_M_size);
 }
 
@@ -491,65 +532,42 @@ void Convolve1<CONV_SIZE>::Forward(const size_t input_channels,
                                    const size_t output_channels,
                                    const std::vector<float> &input,
                                    const std::vector<float> &weights,
-                                   std::vector<float> &output) {
-
-     Blas::fixed_gemm((int)output_channels,
-                       spatial_size,
-                       (int)input_channels,
-                       1.0f,
-                       weights.data(),
-                       (int)input_channels,
-                       input.data(),
-                       spatial_size,
-                       0.0f,
-                       output.data(),
-                       spatial_size);
-}
-
-template<int CONV_SIZE>
-void Batchnorm<CONV_SIZE>::Forward(const size_t channels,
-                                   std::vector<float> &input,
-                                   const std::vector<float> &means,
-                                   const std::vector<float> &stddevs,
-                                   const float *const eltwise,
+                                   std::vector<float> &output,
+                                   const size_t batch_size,
+                                   const float *const biases,
                                    const bool ReLU) {
 
     const auto lambda_ReLU = [&](const auto val) {
         return (val > 0.0f || (!ReLU)) ? val : 0.0f;
     };
 
-    float *input_ptr = input.data();
-    const float *res = eltwise;
-    if (eltwise) {
-        for (auto c = size_t{0}; c < channels; ++c) {
-            const auto mean = means[c];
-            const auto scale_stddev = stddevs[c];
-
-            for (auto b = size_t{0}; b < spatial_size; b++) {
-                float value = *input_ptr;
-                value = scale_stddev * (value - mean) + *res;
-                *input_ptr = lambda_ReLU(value);
-
-                input_ptr++;
-                res++;
-            }
+    for (auto b = size_t{0}; b < batch_size; ++b) {
+        auto output_ptr = output.data() + b * output_channels * spatial_size;
+        Blas::fixed_gemm((int)output_channels,
+                         spatial_size,
+                         (int)input_channels,
+                         1.0f,
+                         weights.data(),
+                         (int)input_channels,
+                         input.data() + b * input_channels * spatial_size,
+                         spatial_size,
+                         0.0f,
+                         output_ptr,
+                         spatial_size);
+
+        if (!biases && !ReLU) {
+            continue;
         }
-    } else {
-        for (auto c = size_t{0}; c < channels; ++c) {
-            const auto mean = means[c];
-            const auto scale_stddev = stddevs[c];
-
-            for (auto b = size_t{0}; b < spatial_size; b++) {
-                float value = *input_ptr;
-                value = scale_stddev * (value - mean);
-                *input_ptr = lambda_ReLU(value);
-                input_ptr++;
+        for (auto c = size_t{0}; c < output_channels; ++c) {
+            const auto bias = biases ? biases[c] : 0.0f;
+            for (auto i = size_t{0}; i < spatial_size; ++i) {
+                *output_ptr = lambda_ReLU(*output_ptr + bias);
+                output_ptr++;
             }
         }
     }
 }
 
-
 template<int CONV_SIZE>
 void Convolve<CONV_SIZE>::im2col(const size_t filter_size,
                                  const int channels,
@@ -667,24 +685,27 @@ void SEUnit<CONV_SIZE>::Forward(const size_t channels,
                                 const std::vector<float> &weights_w1,
                                 const std::vector<float> &weights_b1,
                                 const std::vector<float> &weights_w2,
-                                const std::vector<float> &weights_b2) {
+                                const std::vector<float> &weights_b2,
+                                std::vector<float> &pool,
+                                std::vector<float> &fc_out,
+                                std::vector<float> &scale,
+                                const size_t batch_size) {
 
     using pooling = GlobalAvgPool<CONV_SIZE>;
-    auto pool = std::vector<float>(2 * channels);
-    auto fc_out = std::vector<float>(se_size);
 
-    pooling::Forward(channels, input, pool);
-    FullyConnect::Forward(channels, se_size, pool, weights_w1, weights_b1, fc_out, true);
-    FullyConnect::Forward(se_size, 2*channels, fc_out, weights_w2, weights_b2, pool, false);
+    pooling::Forward(batch_size * channels, input, pool);
+    FullyConnect::Forward(channels, se_size, pool, weights_w1, weights_b1, fc_out, true, batch_size);
+    FullyConnect::Forward(se_size, 2*channels, fc_out, weights_w2, weights_b2, scale, false, batch_size);
 
-    SEProcess(channels, input, residual, pool);
+    SEProcess(channels, input, residual, scale, batch_size);
 }
 
 template<int CONV_SIZE>
 void SEUnit<CONV_SIZE>::SEProcess(const size_t channels,
                                   std::vector<float> &input,
                                   const std::vector<float> &residual,
-                                  const std::vector<float> &scale) {
+                                  const std::vector<float> &scale,
+                                  const size_t batch_size) {
 
     const auto lambda_ReLU = [](const auto val) {
         return (val > 0.0f) ? val : 0;
@@ -694,24 +715,26 @@ void SEUnit<CONV_SIZE>::SEProcess(const size_t channels,
         return 1.0f / (1.0f + std::exp(-val));
     };
 
-    auto gamma_ptr = scale.data();
-    auto beta_ptr = scale.data() + channels;
     auto input_ptr = input.data();
     auto res_ptr = residual.data();
 
+    for (auto b = size_t{0}; b < batch_size; ++b) {
+        auto gamma_ptr = scale.data() + b * 2 * channels;
+        auto beta_ptr = gamma_ptr + channels;
 
-    for (auto c = size_t{0}; c < channels; ++c) {
-        const auto gamma = lambda_sigmoid(*gamma_ptr);
-        const auto beta = *beta_ptr;
+        for (auto c = size_t{0}; c < channels; ++c) {
+            const auto gamma = lambda_sigmoid(*gamma_ptr);
+            const auto beta = *beta_ptr;
 
-        gamma_ptr++;
-        beta_ptr++;
+            gamma_ptr++;
+            beta_ptr++;
 
-        for (auto i = size_t{0}; i < spatial_size; ++i) {
-            float value = *input_ptr;
-            *input_ptr = lambda_ReLU(gamma * value + beta + *res_ptr);
-            input_ptr++;
-            res_ptr++;
+            for (auto i = size_t{0}; i < spatial_size; ++i) {
+                float value = *input_ptr;
+                *input_ptr = lambda_ReLU(gamma * value + beta + *res_ptr);
+                input_ptr++;
+                res_ptr++;
+            }
         }
     }
 }
@@ -722,26 +745,15 @@ void InputPool<CONV_SIZE>::Forward(const size_t input_size,
                                    const std::vector<float> &input,
                                    const std::vector<float> &weights_w,
                                    const std::vector<float> &weights_b,
-                                   std::vector<float> &output) {
+                                   const std::vector<float> &conv_biases,
+                                   std::vector<float> &output,
+                                   const size_t batch_size) {
 
-    auto fc_out = std::vector<float>(channels);
     FullyConnect::Forward(input_size, channels,
-          input, weights_w, weights_b, fc_out, false);
+          input, weights_w, weights_b, output, false, batch_size);
 
-
-    const auto lambda_ReLU = [](const auto val) {
-        return (val > 0.0f) ? val : 0;
-    };
-
-    auto output_ptr = output.data();
-
-    for (auto c = size_t{0}; c < channels; ++c) {
-        float bais = fc_out[c];
-        for (auto i = size_t{0}; i < spatial_size; ++i) {
-            float value = *output_ptr;
-            *output_ptr = lambda_ReLU(value + bais);
-            output_ptr++;
-        }
+    for (auto bc = size_t{0}; bc < batch_size * channels; ++bc) {
+        output[bc] += conv_biases[bc % channels];
     }
 }
 #endif
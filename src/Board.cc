@@ -24,6 +24,8 @@ std::array<std::array<int, NUM_INTERSECTIONS>, Board::NUM_SYMMETRIES>
 std::array<std::array<int, NUM_VERTICES>, Board::NUM_SYMMETRIES>
     Board::symmetry_nn_vtx_table;
 std::array<int, 8> Board::m_dirs;
+std::array<int, NUM_VERTICES> Board::vtx_to_bit_table;
+std::array<int, Bitboard::NUM_BITS> Board::bit_to_vtx_table;
 
 std::pair<int, int> Board::get_symmetry(const int x, const int y,
                                         const int symmetry,
@@ -93,14 +95,33 @@ void Board::init_dirs(const int boardsize) {
     m_dirs[7] = (+x_shift + 1);
 }
 
+void Board::init_bitboard(const int numvertices) {
+
+    vtx_to_bit_table.fill(Bitboard::NUM_BITS);
+    bit_to_vtx_table.fill(NO_VERTEX);
+
+    for (int vtx = 0; vtx < numvertices; ++vtx) {
+        if (is_on_board(vtx)) {
+            const auto x = get_x(vtx);
+            const auto y = get_y(vtx);
+            const auto bit = y * Bitboard::BITBOARD_WIDTH + x;
+            vtx_to_bit_table[vtx] = bit;
+            bit_to_vtx_table[bit] = vtx;
+        }
+    }
+}
+
 void Board::fix_board() {
 
 	const int part_center = m_boardsize / 2;
-	
-	m_state[get_vertex(part_center,part_center)] = WHITE;
-	m_state[get_vertex(part_center-1,part_center-1)] = WHITE;
-	m_state[get_vertex(part_center-1,part_center)] = BLACK;
-	m_state[get_vertex(part_center,part_center-1)] = BLACK;
+	const auto fix_stone = [this](const int vtx, const vertex_t color) {
+		update_stone(vtx, color);
+	};
+
+	fix_stone(get_vertex(part_center,part_center), WHITE);
+	fix_stone(get_vertex(part_center-1,part_center-1), WHITE);
+	fix_stone(get_vertex(part_center-1,part_center), BLACK);
+	fix_stone(get_vertex(part_center,part_center-1), BLACK);
 }
 
 
@@ -116,9 +137,14 @@ void Board::reset_board(const int boardsize, const float komi) {
 
     init_symmetry_table(m_boardsize);
     init_dirs(m_boardsize);
+    init_bitboard(m_numvertices);
 
-    m_hash = calc_hash(NO_VERTEX);
+    m_hash.fill(0ULL);
     fix_board();
+    for (int sym = 0; sym < NUM_SYMMETRIES; ++sym) {
+        m_hash[sym] = calc_hash(NO_VERTEX, sym);
+    }
+    update_legal_moves();
 }
 
 void Board::set_boardsize(int boardsize) {
@@ -154,6 +180,10 @@ void Board::reset_board_data(const int boardsize) {
 			m_state[vertex] = EMPTY;
 		}
 	}
+
+	m_bitboard.fill(0ULL);
+	m_legal_moves.fill(0ULL);
+	m_board_mask = Bitboard::board_mask(boardsize);
 }
 
 void Board::set_passes(int val) {
@@ -226,7 +256,7 @@ void Board::info_stream(std::ostream &out) const {
 void Board::hash_stream(std::ostream &out) const {
 
     out << std::hex;
-    out << "HASH : " << m_hash;
+    out << "HASH : " << get_hash();
     out << "\n";
     out << std::dec;
 }
@@ -347,36 +377,47 @@ void Board::play_move(const int vtx) {
     play_move(vtx, m_tomove);
 }
 
-void Board::reseve(const int vtx, const int color) {
+Bitboard::MASK Board::reseve(const int vtx, const int color) {
 
 	const auto opp_color = !color;
-	auto update_vtx = std::vector<int>{};
+	auto flips = Bitboard::get_flips(vtx_to_bit_table[vtx],
+	                                 m_bitboard[color],
+	                                 m_bitboard[opp_color]);
 	update_stone(vtx, color);
 
-	for(int k = 0; k < 8; ++k){
-		int avtx = vtx;
-		int res = 0;
-		
-		do {
-			avtx += m_dirs[k];
-			res ++;
-		} while (m_state[avtx] == opp_color);
-		
-		if(res > 1 && m_state[avtx] == color){
-			for (int i = 0; i < (res-1); ++i){
-				avtx -= m_dirs[k];
-				update_stone(avtx, color);
-				update_vtx.emplace_back(avtx);
-			}
-		}
+	m_bitboard[color] |= flips;
+	m_bitboard[opp_color] &= ~flips;
+
+	auto remain = flips;
+	while (remain) {
+		const auto avtx = bit_to_vtx_table[Bitboard::lowest(remain)];
+		m_state[avtx] = static_cast<vertex_t>(color);
+		update_zobrist(avtx, color, opp_color);
+		remain = Bitboard::pop_lowest(remain);
 	}
+	return flips;
 }
 
 
 // assume the move is legal
 void Board::play_move(const int vtx, const int color) {
 
+    auto record = MoveRecord{};
+    do_move(vtx, color, record);
+}
+
+void Board::do_move(const int vtx, const int color, MoveRecord &record) {
+
     assert(vtx != Board::RESIGN);
+
+    record.vertex = vtx;
+    record.color = color;
+    record.flips = 0ULL;
+    record.legal_moves = m_legal_moves;
+    record.lastmove = m_lastmove;
+    record.passes = m_passes;
+    record.tomove = m_tomove;
+
     set_to_move(color);
 
     if (vtx == PASS) {
@@ -385,7 +426,8 @@ void Board::play_move(const int vtx, const int color) {
         if (get_passes() != 0) {
             set_passes(0);
         }
-        reseve(vtx, color);
+        record.flips = reseve(vtx, color);
+        update_legal_moves();
     }
 
     m_lastmove = vtx;
@@ -393,15 +435,72 @@ void Board::play_move(const int vtx, const int color) {
     exchange_to_move();
 }
 
+void Board::undo_move(const MoveRecord &record) {
+
+    assert(m_movenum > 0);
+    const auto vtx = record.vertex;
+
+    if (vtx != PASS) {
+        const auto color = record.color;
+        const auto opp_color = !color;
+        const auto flips = record.flips;
+
+        update_stone(vtx, EMPTY);
+
+        auto remain = flips;
+        while (remain) {
+            const auto avtx = bit_to_vtx_table[Bitboard::lowest(remain)];
+            update_stone(avtx, opp_color);
+            remain = Bitboard::pop_lowest(remain);
+        }
+    }
+
+    update_zobrist_pass(record.passes, m_passes);
+    update_zobrist_tomove(record.tomove, m_tomove);
+
+    m_legal_moves = record.legal_moves;
+    m_lastmove = record.lastmove;
+    m_passes = record.passes;
+    m_tomove = record.tomove;
+    m_movenum--;
+}
+
+Board::Snapshot Board::get_snapshot() const {
+    auto snapshot = Snapshot{};
+    snapshot.bitboard = m_bitboard;
+    snapshot.lastmove = m_lastmove;
+    snapshot.passes = m_passes;
+    return snapshot;
+}
+
+Board::vertex_t Board::Snapshot::get_state(const int vtx) const {
+    const auto bit = vtx_to_bit_table[vtx];
+    if (bit == Bitboard::NUM_BITS) {
+        return INVAL;
+    }
+    const auto m = Bitboard::square(bit);
+    if (bitboard[BLACK] & m) {
+        return BLACK;
+    } else if (bitboard[WHITE] & m) {
+        return WHITE;
+    }
+    return EMPTY;
+}
+
+void Board::Snapshot::undo_move(const MoveRecord &record) {
+    const auto vtx = record.vertex;
+    if (vtx != PASS) {
+        const auto color = record.color;
+        const auto flips = record.flips;
+        bitboard[color] &= ~(flips | Bitboard::square(vtx_to_bit_table[vtx]));
+        bitboard[!color] |= flips;
+    }
+    lastmove = record.lastmove;
+    passes = record.passes;
+}
+
 bool Board::is_pass_legal(const int color) const {
-    for (int vtx = 0 ; vtx < m_numvertices; ++vtx){
-		if (m_state[vtx] == EMPTY) {
-			if (is_legal(vtx, color)) {
-				return false;
-			}
-		}
-	}
-    return true;
+    return get_legal_moves(color) == 0ULL;
 }
 
 bool Board::is_legal(const int vtx,
@@ -415,31 +514,18 @@ bool Board::is_legal(const int vtx,
         return is_pass_legal(color);
     }
 
-	const auto opp_color = !color;
-	if(m_state[vtx] == EMPTY){	
-		for(auto k = 0; k < 8; ++k){
-			int avtx = vtx;
-			do {
-				avtx += m_dirs[k];
-			} while (m_state[avtx] == opp_color);
-			
-			if (avtx != (vtx + m_dirs[k]) && m_state[avtx] == color) {
-				return true;
-			}
-		}
+	if (m_state[vtx] != EMPTY) {
+		return false;
 	}
-	return false;
+
+	const auto square = Bitboard::square(vtx_to_bit_table[vtx]);
+	return (get_legal_moves(color) & square) != 0ULL;
 }
 
 int Board::calc_reach_color(int color) const {
 
-    auto res = 0;
-    for (int vtx = 0 ; vtx < m_numvertices; ++vtx){
-		if (m_state[vtx] == color) {
-            res++;
-		}
-	}
-    return res;
+    assert(color == BLACK || color == WHITE);
+    return Bitboard::count(m_bitboard[color]);
 }
 
 float Board::area_score(float komi) const {
@@ -496,7 +582,26 @@ int Board::get_last_move() const {
 }
 
 std::uint64_t Board::get_hash() const {
-    return m_hash;
+    return m_hash[IDENTITY_SYMMETRY];
+}
+
+std::uint64_t Board::get_symmetry_hash(const int symmetry) const {
+    assert(symmetry >= 0 && symmetry < NUM_SYMMETRIES);
+    return m_hash[symmetry];
+}
+
+std::uint64_t Board::get_canonical_hash() const {
+    return m_hash[get_canonical_symmetry()];
+}
+
+int Board::get_canonical_symmetry() const {
+    int best_sym = IDENTITY_SYMMETRY;
+    for (int sym = 1; sym < NUM_SYMMETRIES; ++sym) {
+        if (m_hash[sym] < m_hash[best_sym]) {
+            best_sym = sym;
+        }
+    }
+    return best_sym;
 }
 
 int Board::get_passes() const {
@@ -590,13 +695,13 @@ void Board::sgf_stream(std::ostream &out) const {
 std::vector<int> Board::get_movelist(const int color) const {
 
     auto movelist = std::vector<int>{};
-    for (int vtx = 0 ; vtx < m_numvertices; ++vtx){
-		if (m_state[vtx] == EMPTY) {
-			if (is_legal(vtx, color)) {
-				movelist.emplace_back(vtx);
-			}
-		}
-	}
+    auto moves = get_legal_moves(color);
+    movelist.reserve(Bitboard::count(moves));
+
+    while (moves) {
+        movelist.emplace_back(bit_to_vtx_table[Bitboard::lowest(moves)]);
+        moves = Bitboard::pop_lowest(moves);
+    }
 
     if (movelist.empty()) {
         movelist.emplace_back(Board::PASS);
@@ -630,55 +735,13 @@ bool Board::is_corner(const int vtx) const {
 }
 
 int Board::get_numblacks() const {
-
-    int res = 0;
-
-    for (int y = 0; y < m_boardsize; ++y) {
-        for (int x = 0; x < m_boardsize; ++x) {
-            const auto vtx = get_vertex(x, y);
-            const auto color = m_state[vtx];
-            assert(color != Board::INVAL);
-            if (color == Board::BLACK) {
-                res++;
-            }
-        }
-    }
-
-    return res;
+    return Bitboard::count(m_bitboard[BLACK]);
 }
 
 int Board::get_numwhites() const {
-
-    int res = 0;
-
-    for (int y = 0; y < m_boardsize; ++y) {
-        for (int x = 0; x < m_boardsize; ++x) {
-            const auto vtx = get_vertex(x, y);
-            const auto color = m_state[vtx];
-            assert(color != Board::INVAL);
-            if (color == Board::WHITE) {
-                res++;
-            }
-        }
-    }
-
-    return res;
+    return Bitboard::count(m_bitboard[WHITE]);
 }
 
 int Board::get_numempty() const {
-
-    int res = 0;
-
-    for (int y = 0; y < m_boardsize; ++y) {
-        for (int x = 0; x < m_boardsize; ++x) {
-            const auto vtx = get_vertex(x, y);
-            const auto color = m_state[vtx];
-            assert(color != Board::INVAL);
-            if (color == Board::EMPTY) {
-                res++;
-            }
-        }
-    }
-
-    return res;
+    return Bitboard::count(m_board_mask & ~(m_bitboard[BLACK] | m_bitboard[WHITE]));
 }
@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <cstring>
 
+#include "Bitboard.h"
 #include "Zobrist.h"
 #include "config.h"
 
@@ -58,6 +59,30 @@ public:
 
     static std::array<int, 8> m_dirs;
 
+    // Everything undo_move needs to take back one move.
+    struct MoveRecord {
+        Bitboard::MASK flips;
+        std::array<Bitboard::MASK, 2> legal_moves;
+        int vertex;
+        int color;
+        int lastmove;
+        int passes;
+        int tomove;
+    };
+
+    // The compact copy of one position kept in the game history.
+    struct Snapshot {
+        std::array<Bitboard::MASK, 2> bitboard;
+        int lastmove;
+        int passes;
+
+        vertex_t get_state(const int vtx) const;
+
+        // Take back the move of the record. The record must be the
+        // one which led to this position.
+        void undo_move(const MoveRecord &record);
+    };
+
     void reset_board(const int boardsize, const float komi);
     void set_komi(const float komi);
     void set_boardsize(int boardsize);
@@ -107,6 +132,14 @@ public:
 
     std::uint64_t get_hash() const;
 
+    // The hash of the position transformed by the symmetry.
+    std::uint64_t get_symmetry_hash(const int symmetry) const;
+
+    // The canonical hash is the smallest one of the symmetric
+    // hashes. The symmetric positions share the same canonical hash.
+    std::uint64_t get_canonical_hash() const;
+    int get_canonical_symmetry() const;
+
     std::uint64_t calc_hash(int komove, int sym = IDENTITY_SYMMETRY) const;
     std::uint64_t calc_ko_hash(int sym = IDENTITY_SYMMETRY) const;
     std::uint64_t komi_hash(const float komi) const; 
@@ -122,11 +155,24 @@ public:
     void play_move(const int vtx, const int color);
     void play_move(const int vtx);
 
+    // Play the move in place and take it back later. Assume the move is legal.
+    void do_move(const int vtx, const int color, MoveRecord &record);
+    void undo_move(const MoveRecord &record);
+
+    Snapshot get_snapshot() const;
+
     bool is_legal(const int vtx,
                   const int color) const;
 
     bool is_pass_legal(const int color) const;
 
+    // The legal moves are updated after each move, so these are O(1).
+    Bitboard::MASK get_legal_moves(const int color) const;
+    int get_mobility(const int color) const;
+
+    // The vertex of the bit of the bitboards.
+    static int bit_to_vertex(const int bit);
+
     int calc_reach_color(int color) const;
     int calc_reach_color(int color, int spread_color,
                          std::vector<bool>& buf, std::function<int(int)> f_peek) const;
@@ -147,9 +193,21 @@ public:
     bool is_corner(const int vtx) const;
 
 private:
+    static std::array<int, NUM_VERTICES> vtx_to_bit_table;
+
+    static std::array<int, Bitboard::NUM_BITS> bit_to_vtx_table;
+
     std::array<vertex_t, NUM_VERTICES> m_state;
 
-    std::uint64_t m_hash{0ULL}; 
+    // The black and white discs. They are always consistent with m_state.
+    std::array<Bitboard::MASK, 2> m_bitboard;
+    Bitboard::MASK m_board_mask;
+
+    // The legal moves of both colors on the current position.
+    std::array<Bitboard::MASK, 2> m_legal_moves;
+
+    // The hashes of all symmetries. They are updated incrementally.
+    std::array<std::uint64_t, NUM_SYMMETRIES> m_hash;
 
     int m_tomove; 
     int m_letterboxsize;
@@ -169,7 +227,10 @@ private:
 
     void fix_board();
 
-    void reseve(const int vtx, const int color);
+    Bitboard::MASK get_moves_mask(const int color) const;
+    void update_legal_moves();
+
+    Bitboard::MASK reseve(const int vtx, const int color);
     void update_stone(const int vtx, const int color);
 
     // uupdate zobrist
@@ -226,34 +287,74 @@ inline void Board::update_stone(const int vtx, const int color){
 	const int old_color = m_state[vtx];
 	m_state[vtx] = static_cast<vertex_t>(color);
 
+    const auto square = Bitboard::square(vtx_to_bit_table[vtx]);
+    if (old_color == BLACK || old_color == WHITE) {
+        m_bitboard[old_color] &= ~square;
+    }
+    if (color == BLACK || color == WHITE) {
+        m_bitboard[color] |= square;
+    }
+
     update_zobrist(vtx, color, old_color);
 }
 
+inline Bitboard::MASK Board::get_moves_mask(const int color) const {
+    return Bitboard::get_moves(m_bitboard[color], m_bitboard[!color]) & m_board_mask;
+}
+
+inline void Board::update_legal_moves() {
+    m_legal_moves[BLACK] = get_moves_mask(BLACK);
+    m_legal_moves[WHITE] = get_moves_mask(WHITE);
+}
+
+inline Bitboard::MASK Board::get_legal_moves(const int color) const {
+    assert(color == BLACK || color == WHITE);
+    return m_legal_moves[color];
+}
+
+inline int Board::get_mobility(const int color) const {
+    return Bitboard::count(get_legal_moves(color));
+}
+
+inline int Board::bit_to_vertex(const int bit) {
+    return bit_to_vtx_table[bit];
+}
+
 
 inline void Board::update_zobrist(const int vtx,
                                   const int new_color,
                                   const int old_color) {
-    m_hash ^= Zobrist::zobrist[old_color][vtx];
-    m_hash ^= Zobrist::zobrist[new_color][vtx];
+    for (int sym = 0; sym < NUM_SYMMETRIES; ++sym) {
+        const auto sym_vtx = get_transform_vtx(vtx, sym);
+        m_hash[sym] ^= Zobrist::zobrist[old_color][sym_vtx];
+        m_hash[sym] ^= Zobrist::zobrist[new_color][sym_vtx];
+    }
 }
 
 inline void Board::update_zobrist_tomove(const int new_color,
                                          const int old_color) {
     if (old_color != new_color) {
-        m_hash ^= Zobrist::zobrist_blacktomove;
+        for (auto &h : m_hash) {
+            h ^= Zobrist::zobrist_blacktomove;
+        }
     }
 }
 
 inline void Board::update_zobrist_pass(const int new_pass,
                                        const int old_pass) {
-    m_hash ^= Zobrist::zobrist_pass[old_pass];
-    m_hash ^= Zobrist::zobrist_pass[new_pass];
+    const auto key = Zobrist::zobrist_pass[old_pass] ^
+                         Zobrist::zobrist_pass[new_pass];
+    for (auto &h : m_hash) {
+        h ^= key;
+    }
 }
 
 inline void Board::update_zobrist_komi(const float new_komi,
                                        const float old_komi) {
-    m_hash ^= komi_hash(old_komi);
-    m_hash ^= komi_hash(new_komi);
+    const auto key = komi_hash(old_komi) ^ komi_hash(new_komi);
+    for (auto &h : m_hash) {
+        h ^= key;
+    }
 }
 
 inline int Board::get_x(const int vtx) const {
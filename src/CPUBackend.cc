@@ -1,9 +1,18 @@
 #include "CPUBackend.h"
 #include "Utils.h"
+
+#include <algorithm>
+
 template<int BSIZE>
 class FORWARD_PIPE {
 public:
+// The positions of the batch go through each layer together. The
+// Winograd tiles of all positions are in one GEMM. The batch normalizations
+// are folded into the convolutions, and their biases and ReLUs are applied
+// in the epilogues of the convolutions.
 void forward(std::shared_ptr<Model::NNweights> m_weights,
+             CPUbackend::Workspace &workspace,
+             const size_t batch_size,
              const  std::vector<float> &planes,
              const  std::vector<float> &features,
              std::vector<float> &output_pol,
@@ -12,7 +21,6 @@ void forward(std::shared_ptr<Model::NNweights> m_weights,
              std::vector<float> &output_fs,
              std::vector<float> &output_val) {
 
-    using batchnorm = Batchnorm<BSIZE>;
     using convolve_3 = winograd_convolve3<BSIZE>;
     using convolve_1 = Convolve1<BSIZE>;
     using se_unit = SEUnit<BSIZE>;
@@ -22,39 +30,28 @@ void forward(std::shared_ptr<Model::NNweights> m_weights,
     const size_t intersections = BSIZE * BSIZE; 
 
     size_t output_channels = m_weights->channels;
-    size_t input_channels = std::max(static_cast<size_t>(output_channels),
-                                     static_cast<size_t>(INPUT_CHANNELS));
-    const auto workspace_size = 
-                   convolve_3::get_workspace_size(input_channels, output_channels);
-    const auto winograd_V_size = workspace_size.first;
-    const auto winograd_M_size = workspace_size.second;
-
-
-    auto winograd_V = std::vector<float>(winograd_V_size);
-    auto winograd_M = std::vector<float>(winograd_M_size);
-
+    size_t input_channels = INPUT_CHANNELS;
 
-    auto conv_out = std::vector<float>(output_channels * intersections);
-    auto conv_in = std::vector<float>(output_channels * intersections);
-    auto res = std::vector<float>(output_channels * intersections);
-
-    input_channels = INPUT_CHANNELS;
-
-    convolve_3::Forward(input_channels, output_channels, planes,
-                        m_weights->input_conv.weights, 
-                        winograd_V, winograd_M, conv_out);
+    workspace.reserve(BSIZE, output_channels, batch_size);
 
+    auto &winograd_V = workspace.winograd_V;
+    auto &winograd_M = workspace.winograd_M;
 
-    batchnorm::Forward(output_channels, conv_out,
-                       m_weights->input_bn.means,
-                       m_weights->input_bn.stddevs,
-                       nullptr, false);
+    auto &conv_out = workspace.conv_out;
+    auto &conv_in = workspace.conv_in;
+    auto &res = workspace.res;
 
     inputpool::Forward(INPUT_FEATURES, output_channels,
                        features,
                        m_weights->input_fc.weights,
                        m_weights->input_fc.biases,
-                       conv_out);
+                       m_weights->input_conv.biases,
+                       workspace.input_fc, batch_size);
+
+    convolve_3::Forward(input_channels, output_channels, planes,
+                        m_weights->input_conv.weights, 
+                        winograd_V, winograd_M, conv_out, batch_size,
+                        workspace.input_fc.data(), output_channels, true);
 
     input_channels = m_weights->channels;
 
@@ -68,50 +65,47 @@ void forward(std::shared_ptr<Model::NNweights> m_weights,
         std::swap(conv_in, conv_out);
         convolve_3::Forward(input_channels, tower_channels, conv_in,
                             tower_ptr->conv_1.weights,
-                            winograd_V, winograd_M, conv_out);
-
-        batchnorm::Forward(tower_channels, conv_out,
-                           tower_ptr->bn_1.means,
-                           tower_ptr->bn_1.stddevs);
+                            winograd_V, winograd_M, conv_out, batch_size,
+                            tower_ptr->conv_1.biases.data(), 0, true);
 
         std::swap(conv_in, res);
         std::swap(conv_out, conv_in);
         convolve_3::Forward(input_channels, tower_channels, conv_in,
                             tower_ptr->conv_2.weights,
-                            winograd_V, winograd_M, conv_out);
-
-        batchnorm::Forward(tower_channels, conv_out,
-                           tower_ptr->bn_2.means,
-                           tower_ptr->bn_2.stddevs,
-                           nullptr, false);   
+                            winograd_V, winograd_M, conv_out, batch_size,
+                            tower_ptr->conv_2.biases.data(), 0, false);
 
+        // The residual is added after the SE scales the output, so it is
+        // fused into the SE process instead of the convolution.
         const size_t se_size = 4 * tower_channels;
         se_unit::Forward(tower_channels, se_size,
                          conv_out, res, 
                          tower_ptr->extend.weights,
                          tower_ptr->extend.biases,
                          tower_ptr->squeeze.weights,
-                         tower_ptr->squeeze.biases);
+                         tower_ptr->squeeze.biases,
+                         workspace.se_pool,
+                         workspace.se_fc,
+                         workspace.se_scale,
+                         batch_size);
     }
 
     // policy head
-    auto policy_conv = std::vector<float>(OUTPUTS_POLICY * intersections);
-    auto policy_pool = std::vector<float>(OUTPUTS_POLICY);
-    auto pass_out = std::vector<float>(1);
+    auto &policy_conv = workspace.policy_conv;
+    auto &policy_pool = workspace.policy_pool;
+    auto &prob_out = workspace.prob_out;
+    auto &pass_out = workspace.pass_out;
 
     convolve_1::Forward(input_channels, OUTPUTS_POLICY, conv_out, 
                         m_weights->p_conv.weights,
-                        policy_conv);
-
-    batchnorm::Forward(OUTPUTS_POLICY, policy_conv, 
-                       m_weights->p_bn.means,
-                       m_weights->p_bn.stddevs);
+                        policy_conv, batch_size,
+                        m_weights->p_conv.biases.data(), true);
 
     convolve_1::Forward(OUTPUTS_POLICY, OUTPUTS_PRBAOBILITIES, policy_conv, 
                         m_weights->prob_conv.weights,
-                        output_pol);
+                        prob_out, batch_size);
 
-    globalpool::Forward(OUTPUTS_POLICY,
+    globalpool::Forward(batch_size * OUTPUTS_POLICY,
                         policy_conv,
                         policy_pool);
 
@@ -120,32 +114,35 @@ void forward(std::shared_ptr<Model::NNweights> m_weights,
                           policy_pool, 
                           m_weights->pass_fc.weights,
                           m_weights->pass_fc.biases, 
-                          pass_out, false);
+                          pass_out, false, batch_size);
 
     // probabilities
-    output_pol[intersections] = pass_out[0];
+    for (auto b = size_t{0}; b < batch_size; ++b) {
+        const auto prob_begin = std::begin(prob_out) + b * intersections;
+        const auto pol_begin = std::begin(output_pol) + b * POTENTIAL_MOVES;
+        std::copy(prob_begin, prob_begin + intersections, pol_begin);
+        pol_begin[intersections] = pass_out[b];
+    }
 
     // value head
-    auto value_conv = std::vector<float>(OUTPUTS_VALUE * intersections);
-    auto value_pool = std::vector<float>(OUTPUTS_VALUE);
+    auto &value_conv = workspace.value_conv;
+    auto &value_pool = workspace.value_pool;
 
     convolve_1::Forward(input_channels, OUTPUTS_VALUE, conv_out, 
                         m_weights->v_conv.weights,
-                        value_conv);
+                        value_conv, batch_size,
+                        m_weights->v_conv.biases.data(), true);
 
-    batchnorm::Forward(OUTPUTS_VALUE, value_conv, 
-                       m_weights->v_bn.means,
-                       m_weights->v_bn.stddevs);
     // score belief
     convolve_1::Forward(OUTPUTS_VALUE, OUTPUTS_SCOREBELIEF, value_conv, 
                       m_weights->sb_conv.weights,
-                      output_sb);
+                      output_sb, batch_size);
     // ownership
     convolve_1::Forward(OUTPUTS_VALUE, OUTPUTS_OWNERSHIP, value_conv, 
                         m_weights->os_conv.weights,
-                        output_os);
+                        output_os, batch_size);
 
-    globalpool::Forward(OUTPUTS_VALUE,
+    globalpool::Forward(batch_size * OUTPUTS_VALUE,
                         value_conv,
                         value_pool);
 
@@ -154,30 +151,78 @@ void forward(std::shared_ptr<Model::NNweights> m_weights,
                           value_pool, 
                           m_weights->fs_fc.weights,
                           m_weights->fs_fc.biases, 
-                          output_fs, false);
+                          output_fs, false, batch_size);
 
     // winrate misc
     FullyConnect::Forward(OUTPUTS_VALUE, VALUE_MISC,
                           value_pool, 
                           m_weights->v_fc.weights,
                           m_weights->v_fc.biases, 
-                          output_val, false);
+                          output_val, false, batch_size);
 }
 };
 
-#define CASE_PIPE(BSIZE)                               \
-case BSIZE:                                            \
-    {                                                  \
-        auto pipe = FORWARD_PIPE<BSIZE>();             \
-        pipe.forward(m_weights, planes, features,      \
-                    output_pol, output_sb,             \
-                    output_os, output_fs, output_val); \
-    }                                                  \
+#define CASE_PIPE(BSIZE)                                   \
+case BSIZE:                                                \
+    {                                                      \
+        auto pipe = FORWARD_PIPE<BSIZE>();                 \
+        pipe.forward(m_weights, *workspace, batch_size,    \
+                     planes, features,                     \
+                     output_pol, output_sb,                \
+                     output_os, output_fs, output_val);    \
+    }                                                      \
     break; 
 
+void CPUbackend::Workspace::reserve(const int boardsize,
+                                    const size_t channels,
+                                    const size_t batch_size) {
+
+    const auto grow = [](std::vector<float> &buffer, const size_t size) {
+        if (buffer.size() < size) {
+            buffer.resize(size);
+        }
+    };
+
+    const size_t intersections = boardsize * boardsize;
+    const size_t wtiles = boardsize / WINOGRAD_M + (boardsize % WINOGRAD_M != 0);
+    const size_t input_channels = std::max(channels, static_cast<size_t>(INPUT_CHANNELS));
+
+    grow(winograd_V, WINOGRAD_TILE * input_channels * wtiles * wtiles * batch_size);
+    grow(winograd_M, WINOGRAD_TILE * channels * wtiles * wtiles * batch_size);
+
+    grow(conv_in, batch_size * channels * intersections);
+    grow(conv_out, batch_size * channels * intersections);
+    grow(res, batch_size * channels * intersections);
+
+    grow(input_fc, batch_size * channels);
+    grow(se_pool, batch_size * channels);
+    grow(se_fc, batch_size * 4 * channels);
+    grow(se_scale, batch_size * 2 * channels);
+
+    grow(policy_conv, batch_size * OUTPUTS_POLICY * intersections);
+    grow(policy_pool, batch_size * OUTPUTS_POLICY);
+    grow(prob_out, batch_size * intersections);
+    grow(pass_out, batch_size);
+
+    grow(value_conv, batch_size * OUTPUTS_VALUE * intersections);
+    grow(value_pool, batch_size * OUTPUTS_VALUE);
+}
+
+void CPUbackend::prepare_workspace() {
+    m_workspaces.clear();
+    if (!valid()) {
+        return;
+    }
+    const auto batch_size = std::max(option<int>("batchsize"), option<int>("leaf_batch"));
+    auto workspace = m_workspaces.acquire();
+    workspace->reserve(option<int>("boardsize"), m_weights->channels, batch_size);
+    m_workspaces.release(std::move(workspace));
+}
+
 void CPUbackend::initialize(std::shared_ptr<Model::NNweights> weights) {
     m_weights = weights;
     Model::winograd_transform(m_weights);
+    prepare_workspace();
 }
 
 void CPUbackend::reload(std::shared_ptr<Model::NNweights> weights) {
@@ -186,6 +231,7 @@ void CPUbackend::reload(std::shared_ptr<Model::NNweights> weights) {
     }
     m_weights = weights;
     Model::winograd_transform(m_weights);
+    prepare_workspace();
 }
 
 void CPUbackend::forward(const int boardsize,
@@ -197,6 +243,22 @@ void CPUbackend::forward(const int boardsize,
                          std::vector<float> &output_fs,
                          std::vector<float> &output_val) {
 
+    forward_batch(boardsize, 1, planes, features,
+                  output_pol, output_sb, output_os, output_fs, output_val);
+}
+
+void CPUbackend::forward_batch(const int boardsize,
+                               const int batch_size,
+                               const std::vector<float> &planes,
+                               const std::vector<float> &features,
+                               std::vector<float> &output_pol,
+                               std::vector<float> &output_sb,
+                               std::vector<float> &output_os,
+                               std::vector<float> &output_fs,
+                               std::vector<float> &output_val) {
+
+    auto workspace = m_workspaces.acquire();
+
     switch (boardsize) {
         CASE_PIPE(2);
         CASE_PIPE(3);
@@ -226,6 +288,8 @@ void CPUbackend::forward(const int boardsize,
             Utils::auto_printf("Not support for %d x %d board\n", boardsize, boardsize);
             break;
     }
+
+    m_workspaces.release(std::move(workspace));
 }
 
 void CPUbackend::release() {
@@ -233,6 +297,7 @@ void CPUbackend::release() {
         m_weights.reset();
     }
     m_weights = nullptr;
+    m_workspaces.clear();
 }
 
 bool CPUbackend::valid() {
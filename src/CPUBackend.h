@@ -3,6 +3,10 @@
 #include "Model.h"
 #include "config.h"
 #include "Blas.h"
+#include "WorkspacePool.h"
+
+#include <memory>
+#include <vector>
 
 class CPUbackend : public Model::NNpipe {
 public:
@@ -16,13 +20,55 @@ public:
                          std::vector<float> &output_fs,
                          std::vector<float> &output_val);
 
+    virtual void forward_batch(const int boardsize,
+                               const int batch_size,
+                               const std::vector<float> &planes,
+                               const std::vector<float> &binary,
+                               std::vector<float> &output_pol,
+                               std::vector<float> &output_sb,
+                               std::vector<float> &output_os,
+                               std::vector<float> &output_fs,
+                               std::vector<float> &output_val);
+
     virtual void reload(std::shared_ptr<Model::NNweights> weights);
     virtual void release();
     virtual void destroy() {}
     virtual bool valid();
 
+    // The buffers of one forward. They only grow, so they are allocated
+    // only for a larger board or batch than before.
+    struct Workspace {
+        std::vector<float> winograd_V;
+        std::vector<float> winograd_M;
+
+        std::vector<float> conv_in;
+        std::vector<float> conv_out;
+        std::vector<float> res;
+
+        std::vector<float> input_fc;
+        std::vector<float> se_pool;
+        std::vector<float> se_fc;
+        std::vector<float> se_scale;
+
+        std::vector<float> policy_conv;
+        std::vector<float> policy_pool;
+        std::vector<float> prob_out;
+        std::vector<float> pass_out;
+
+        std::vector<float> value_conv;
+        std::vector<float> value_pool;
+
+        void reserve(const int boardsize, const size_t channels,
+                     const size_t batch_size);
+    };
+
 private:
+    // Size the first workspace for the board and the batches of the
+    // options, so even the first forward allocates nothing.
+    void prepare_workspace();
+
     std::shared_ptr<Model::NNweights> m_weights{nullptr};
+    WorkspacePool<Workspace> m_workspaces;
 
 };
 
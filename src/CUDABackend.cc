@@ -3,18 +3,16 @@
 #include "config.h"
 #include "Utils.h"
 
+#include <algorithm>
 #include <iterator>
-#include <chrono>
 
 void CUDAbackend::destroy() {
     release();
-    quit_worker();
     auto_printf("CUDA network was released.\n");
 }
 
 void CUDAbackend::initialize(std::shared_ptr<Model::NNweights> weights) {
     auto_printf("Using CUDA network.\n");
-    prepare_worker();
     if (m_weights == nullptr) {
         m_weights = weights;
     }
@@ -24,7 +22,6 @@ void CUDAbackend::initialize(std::shared_ptr<Model::NNweights> weights) {
     }
     handel.apply();
     cuda_gpu_info();
-    m_waittime.store(option<int>("waittime"));
 }
 
 
@@ -45,182 +42,82 @@ void CUDAbackend::forward(const int boardsize,
                           std::vector<float> &output_os,
                           std::vector<float> &output_fs,
                           std::vector<float> &output_val) {
-    if (option<int>("batchsize") == 1) {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        const auto batch_size = size_t{1};
-        auto in_planes = planes;
-        auto in_features = features;
-        batch_forward(batch_size,
-                      boardsize,
-                      in_planes,
-                      in_features,
-                      output_pol,
-                      output_sb,
-                      output_os,
-                      output_fs,
-                      output_val);
-    } else {
-        auto entry = std::make_shared<ForwawrdEntry>(boardsize,
-                                                     planes,
-                                                     features,
-                                                     output_pol,
-                                                     output_sb,
-                                                     output_os,
-                                                     output_fs,
-                                                     output_val);
-        std::unique_lock<std::mutex> lock(entry->mutex);
-        {
-            std::unique_lock<std::mutex> queue_lock(m_queue_mutex);
-            m_forward_queue.emplace_back(entry);
-        }
-        if (m_forward_queue.size() >= (size_t)option<int>("batchsize")) {
-            m_cv.notify_one();
-        }
-        entry->cv.wait(lock);
-        entry->done.store(true);
-    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const auto batch_size = size_t{1};
+    auto in_planes = planes;
+    auto in_features = features;
+    batch_forward(batch_size,
+                  boardsize,
+                  in_planes,
+                  in_features,
+                  output_pol,
+                  output_sb,
+                  output_os,
+                  output_fs,
+                  output_val);
 }
 
-void CUDAbackend::prepare_worker() {
-    m_thread_running = true;
-    if (m_threads.size() == 0 && option<int>("batchsize") > 1) {
-        m_threads.emplace_back([this](){ worker(); });
-    }
-}
+void CUDAbackend::forward_batch(const int boardsize,
+                                const int batch_size,
+                                const std::vector<float> &planes,
+                                const std::vector<float> &features,
+                                std::vector<float> &output_pol,
+                                std::vector<float> &output_sb,
+                                std::vector<float> &output_os,
+                                std::vector<float> &output_fs,
+                                std::vector<float> &output_val) {
 
-void CUDAbackend::quit_worker() {
-    {
-        std::unique_lock<std::mutex> queue_lock(m_queue_mutex);
-        m_thread_running = false;
-    }
-    m_cv.notify_all();
-    for (auto &t : m_threads) {
-        t.join();
-    }
-}
+    const auto max_batch_size = option<int>("batchsize");
 
-void CUDAbackend::worker() {
-
-    const auto gether_batches = [this](){
-        std::list<std::shared_ptr<ForwawrdEntry>> inputs;
-    
-        while(true) {
-            if (!m_thread_running) {
-                return inputs;
-            }
-            if (m_forward_queue.size() >= (size_t)option<int>("batchsize")) {
-                m_waittime.store(option<int>("waittime"));
-                break;
-            }
-
-            std::unique_lock<std::mutex> lock(m_mutex);
-            int waittime = m_waittime.load();
-            bool timeout = m_cv.wait_for(lock, std::chrono::milliseconds(waittime),
-                                             [this](){ return m_forward_queue.size() < 
-                                                                   (size_t)option<int>("batchsize"); }
-                                         );
-            if (!m_forward_queue.empty()) {
-                if (timeout && m_narrow_pipe.exchange(true) == false) {
-                    if (waittime > 1) {
-                        waittime--;
-                        m_waittime.store(waittime);
-                    }
-                    break;
-                }
-            }
-        }
-
-        std::unique_lock<std::mutex> queue_lock(m_queue_mutex);
-        auto count = m_forward_queue.size();
-        if (count > (size_t)option<int>("batchsize")) {
-            count = (size_t)option<int>("batchsize");
-        }
-
-        auto end = std::begin(m_forward_queue);
-        std::advance(end, count);
-        std::move(std::begin(m_forward_queue), end, std::back_inserter(inputs));
-        m_forward_queue.erase(std::begin(m_forward_queue), end);
-
-        return inputs;
+    // The buffers may be larger than the batch.
+    const size_t intersections = boardsize * boardsize;
+    const size_t in_p_size = INPUT_CHANNELS * intersections;
+    const size_t in_f_size = INPUT_FEATURES;
+    const size_t out_pol_size = POTENTIAL_MOVES;
+    const size_t out_sb_size = OUTPUTS_SCOREBELIEF * intersections;
+    const size_t out_os_size = OUTPUTS_OWNERSHIP * intersections;
+    const size_t out_fs_size = FINAL_SCORE;
+    const size_t out_val_size = VALUE_MISC;
+
+    const auto slice = [](const std::vector<float> &batch,
+                          const int begin, const int end, const size_t size) {
+        return std::vector<float>(std::begin(batch) + begin * size,
+                                  std::begin(batch) + end * size);
     };
+    const auto unslice = [](const std::vector<float> &piece,
+                            std::vector<float> &batch,
+                            const int begin, const size_t size) {
+        std::copy(std::begin(piece), std::end(piece),
+                  std::begin(batch) + begin * size);
+    };
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (int begin = 0; begin < batch_size; begin += max_batch_size) {
+        const auto end = std::min(begin + max_batch_size, batch_size);
 
+        auto in_planes = slice(planes, begin, end, in_p_size);
+        auto in_features = slice(features, begin, end, in_f_size);
+        auto out_pol = slice(output_pol, begin, end, out_pol_size);
+        auto out_sb = slice(output_sb, begin, end, out_sb_size);
+        auto out_os = slice(output_os, begin, end, out_os_size);
+        auto out_fs = slice(output_fs, begin, end, out_fs_size);
+        auto out_val = slice(output_val, begin, end, out_val_size);
 
-    while (true) {
-        if (!m_thread_running) return;
-
-        auto gather_entry = gether_batches();
-        const auto batch_size = gather_entry.size();
-
-        if (batch_size == 0) {
-            continue;
-        }
-
-        const auto first = *std::begin(gather_entry);
-        const auto boardsize = first->boardsize;
-
-        const auto in_p_size = first->in_p.size();
-        const auto in_f_size = first->in_f.size();
-
-        const auto out_pol_size = first->out_pol.size();
-        const auto out_sb_size = first->out_sb.size();
-        const auto out_os_size = first->out_os.size();
-        const auto out_fs_size = first->out_fs.size();
-        const auto out_val_size = first->out_val.size();
-
-        auto batch_input_planes = std::vector<float>(batch_size * in_p_size);
-        auto batch_input_features = std::vector<float>(batch_size * in_f_size);
-        auto batch_out_pol = std::vector<float>(batch_size * out_pol_size);
-        auto batch_out_sb = std::vector<float>(batch_size * out_sb_size);
-        auto batch_out_os = std::vector<float>(batch_size * out_os_size);
-        auto batch_out_fs = std::vector<float>(batch_size * out_fs_size);
-        auto batch_out_val = std::vector<float>(batch_size * out_val_size);
-
-        auto index = size_t{0};
-        for (auto &x : gather_entry) {
-            std::copy(std::begin(x->in_p),
-                      std::end(x->in_p),
-                      std::begin(batch_input_planes) + index * in_p_size);
-            std::copy(std::begin(x->in_f),
-                      std::end(x->in_f),
-                      std::begin(batch_input_features) + index * in_f_size);
-            index++;
-        }
-
-        batch_forward(batch_size,
+        batch_forward(end - begin,
                       boardsize,
-                      batch_input_planes,
-                      batch_input_features,
-                      batch_out_pol,
-                      batch_out_sb,
-                      batch_out_os,
-                      batch_out_fs,
-                      batch_out_val);
-
-        index = 0;
-        for (auto &x : gather_entry) {
-            std::copy(std::begin(batch_out_pol) + index * out_pol_size,
-                      std::begin(batch_out_pol) + (index+1) * out_pol_size,
-                      std::begin(x->out_pol));
-            std::copy(std::begin(batch_out_sb) + index * out_sb_size,
-                      std::begin(batch_out_sb) + (index+1) * out_sb_size,
-                      std::begin(x->out_sb));
-            std::copy(std::begin(batch_out_os) + index * out_os_size,
-                      std::begin(batch_out_os) + (index+1) * out_os_size,
-                      std::begin(x->out_os));
-            std::copy(std::begin(batch_out_fs) + index * out_fs_size,
-                      std::begin(batch_out_fs) + (index+1) * out_fs_size,
-                      std::begin(x->out_fs));
-            std::copy(std::begin(batch_out_val) + index * out_val_size,
-                      std::begin(batch_out_val) + (index+1) * out_val_size,
-                      std::begin(x->out_val));
-            while (!x->done.load()) {
-                x->cv.notify_all();
-            }
-            index++;
-        }
-        if (batch_size <= (size_t)option<int>("batchsize")) {
-            m_narrow_pipe.store(false);
-        }
+                      in_planes,
+                      in_features,
+                      out_pol,
+                      out_sb,
+                      out_os,
+                      out_fs,
+                      out_val);
+
+        unslice(out_pol, output_pol, begin, out_pol_size);
+        unslice(out_sb, output_sb, begin, out_sb_size);
+        unslice(out_os, output_os, begin, out_os_size);
+        unslice(out_fs, output_fs, begin, out_fs_size);
+        unslice(out_val, output_val, begin, out_val_size);
     }
 }
 
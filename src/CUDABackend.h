@@ -9,12 +9,9 @@
 
 #include <atomic>
 #include <memory>
-#include <list>
 #include <array>
 #include <vector>
 #include <mutex>
-#include <thread>
-#include <condition_variable>
 
 class CUDAbackend : public Model::NNpipe {
 public:
@@ -27,6 +24,19 @@ public:
                          std::vector<float> &output_os,
                          std::vector<float> &output_fs,
                          std::vector<float> &output_val);
+
+    // The batch is split into the pieces of the batchsize option, the
+    // size of the buffers on the device.
+    virtual void forward_batch(const int boardsize,
+                               const int batch_size,
+                               const std::vector<float> &planes,
+                               const std::vector<float> &features,
+                               std::vector<float> &output_pol,
+                               std::vector<float> &output_sb,
+                               std::vector<float> &output_os,
+                               std::vector<float> &output_fs,
+                               std::vector<float> &output_val);
+
     virtual void reload(std::shared_ptr<Model::NNweights> weights);
     virtual void release();
     virtual void destroy();
@@ -39,7 +49,6 @@ private:
 
     CudaHandel handel;
     bool is_applied{false};
-    std::atomic<bool> m_thread_running;
 
    struct Graph {
         // intput
@@ -92,37 +101,7 @@ private:
     float *cuda_output_val;
 
     std::mutex m_mutex;
-    std::mutex m_queue_mutex;
-    std::condition_variable m_cv;
-    std::atomic<int> m_waittime{0};
-    std::atomic<bool> m_narrow_pipe{false};
-
-    struct ForwawrdEntry {
-        const size_t boardsize;
-	    const std::vector<float> &in_p;
-        const std::vector<float> &in_f;
-        std::vector<float> &out_pol;
-        std::vector<float> &out_sb;
-        std::vector<float> &out_os;
-        std::vector<float> &out_fs;
-        std::vector<float> &out_val;
-        std::condition_variable cv;
-        std::mutex mutex;
-        std::atomic<bool> done{false};
-
-        ForwawrdEntry(const int bsize,
-                      const std::vector<float> &planes,
-                      const std::vector<float> &features,
-                      std::vector<float> &output_pol,
-                      std::vector<float> &output_sb,
-                      std::vector<float> &output_os,
-                      std::vector<float> &output_fs,
-                      std::vector<float> &output_val) :
-                      boardsize(bsize), in_p(planes), in_f(features),
-                      out_pol(output_pol), out_sb(output_sb), out_os(output_os), out_fs(output_fs), out_val(output_val) {}
-    };
 
-    std::list<std::shared_ptr<ForwawrdEntry>> m_forward_queue;
     void batch_forward(const int batch_size,
                        const int boardsize,
                        std::vector<float> &planes,
@@ -132,11 +111,6 @@ private:
                        std::vector<float> &output_os,
                        std::vector<float> &output_fs,
                        std::vector<float> &output_val);
-
-    std::vector<std::thread> m_threads;
-    void prepare_worker();
-    void worker();
-    void quit_worker();
 }; 
 #endif
 #endif
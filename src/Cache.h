@@ -1,13 +1,15 @@
 #ifndef CACHE_H_INCLUDE
 #define CACHE_H_INCLUDE
 
+#include <algorithm>
 #include <array>
-#include <deque>
-#include <memory>
-#include <mutex>
-#include <unordered_map>
 #include <atomic>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
 
 #include "config.h"
 #include "Utils.h"
@@ -32,10 +34,103 @@ struct NNResult {
     // std::array<float, 21> multi_labeled;
 };
 
+static_assert(NUM_INTERSECTIONS <= 64, "The policy mask only supports 64 intersections!\n");
+
+/*
+ * The compact form of NNResult kept in the NN cache. Only the policy of
+ * the legal moves is stored, in half precision. The ownership is
+ * quantized to 8 bits.
+ */
+struct CompressedNNResult {
+    // The legal moves rarely exceed it. The position is not
+    // cached if it does.
+    static constexpr int MAX_POLICY_MOVES = 32;
+
+    static constexpr float OWNERSHIP_SCALE = 127.0f;
+
+    // Bit idx is set if the policy of the index is stored.
+    std::uint64_t policy_mask;
+
+    float policy_pass;
+    float final_score;
+
+    float alpha;
+    float beta;
+    float gamma;
+
+    std::array<std::uint16_t, MAX_POLICY_MOVES> policy;
+    std::array<std::int8_t, NUM_INTERSECTIONS> ownership;
+
+    bool compress(const NNResult &result, const std::uint64_t legal_mask);
+    void decompress(NNResult &result) const;
+};
+
+inline bool CompressedNNResult::compress(const NNResult &result,
+                                         const std::uint64_t legal_mask) {
+    if (__builtin_popcountll(legal_mask) > MAX_POLICY_MOVES) {
+        return false;
+    }
+
+    policy_mask = legal_mask;
+    policy_pass = result.policy_pass;
+    final_score = result.final_score;
+    alpha = result.alpha;
+    beta = result.beta;
+    gamma = result.gamma;
+
+    auto remain = legal_mask;
+    auto i = 0;
+    while (remain) {
+        const auto idx = __builtin_ctzll(remain);
+        policy[i++] = Utils::float_to_half(result.policy[idx]);
+        remain &= remain - 1;
+    }
+    for (; i < MAX_POLICY_MOVES; ++i) {
+        policy[i] = 0;
+    }
+
+    const auto scale = OWNERSHIP_SCALE;
+    for (int idx = 0; idx < NUM_INTERSECTIONS; ++idx) {
+        const auto v = std::round(result.ownership[idx] * scale);
+        ownership[idx] = static_cast<std::int8_t>(std::max(-scale, std::min(scale, v)));
+    }
+    return true;
+}
+
+inline void CompressedNNResult::decompress(NNResult &result) const {
+    result.policy_pass = policy_pass;
+    result.final_score = final_score;
+    result.alpha = alpha;
+    result.beta = beta;
+    result.gamma = gamma;
+
+    result.policy.fill(0.0f);
+    auto remain = policy_mask;
+    auto i = 0;
+    while (remain) {
+        const auto idx = __builtin_ctzll(remain);
+        result.policy[idx] = Utils::half_to_float(policy[i++]);
+        remain &= remain - 1;
+    }
+
+    for (int idx = 0; idx < NUM_INTERSECTIONS; ++idx) {
+        result.ownership[idx] = static_cast<float>(ownership[idx]) / OWNERSHIP_SCALE;
+    }
+}
+
+/*
+ * The cache is a fixed-size open addressing table. Every slot is guarded
+ * by its own sequence lock, so lookup and insert never take a global lock.
+ * The sequence is odd while a writer is changing the slot. A reader copies
+ * the result and accepts it only if the sequence is even and unchanged.
+ * The replacement is the clock (second chance) policy over the probed slots.
+ *
+ * resize() must not be called while other threads use the cache.
+ */
 template <typename EvalResult>
 class Cache {
 public:
-    Cache(size_t size = MAX_CACHE_COUNT)
+    Cache(size_t size = MIN_CACHE_COUNT)
         : m_hits(0), m_lookups(0), m_inserts(0) {
         resize(size);
     }
@@ -44,6 +139,10 @@ public:
     void insert(std::uint64_t hash, const EvalResult &result);
     void resize(size_t size);
 
+    // Resize the cache to fit the memory budget. The budget is clamped
+    // to the bounds of the cache_memory_mb option.
+    void set_memory(int megabytes);
+
     void dump_stats();
 
     size_t get_estimated_size();
@@ -51,98 +150,189 @@ public:
     void clear();
 
 private:
-    static constexpr size_t MAX_CACHE_COUNT = 150000;
+    static_assert(std::is_trivially_copyable<EvalResult>::value,
+                      "The cache result must be trivially copyable!\n");
 
     static constexpr size_t MIN_CACHE_COUNT = 6000;
 
-    static constexpr size_t ENTRY_SIZE = sizeof(EvalResult) +
-                                         sizeof(std::uint64_t) +
-                                         sizeof(std::unique_ptr<EvalResult>);
-
-    std::mutex m_mutex;
-    size_t m_size;
+    static constexpr size_t PROBE_SLOTS = 4;
 
-    int m_hits;
-    int m_lookups;
-    int m_inserts;
+    static constexpr std::uint64_t EMPTY_HASH = 0ULL;
 
-    struct Entry {
-        Entry(const EvalResult &r) : result(r) {}
+    struct Slot {
+        std::atomic<std::uint32_t> sequence{0};
+        std::atomic<bool> referenced{false};
+        std::atomic<std::uint64_t> hash{EMPTY_HASH};
         EvalResult result;
     };
 
-    std::unordered_map<std::uint64_t, std::unique_ptr<const Entry>> m_cache;
-    std::deque<std::uint64_t> m_order;
+    static constexpr size_t ENTRY_SIZE = sizeof(Slot);
+
+    bool lock_slot(Slot &slot, std::uint32_t &sequence);
+    void unlock_slot(Slot &slot, const std::uint32_t sequence);
+    Slot &get_slot(const std::uint64_t hash, const size_t probe);
+
+    std::vector<Slot> m_slots;
+
+    std::atomic<int> m_hits;
+    std::atomic<int> m_lookups;
+    std::atomic<int> m_inserts;
 };
 
+template <typename EvalResult>
+bool Cache<EvalResult>::lock_slot(Slot &slot, std::uint32_t &sequence) {
+    sequence = slot.sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1) != 0 ||
+            !slot.sequence.compare_exchange_strong(sequence, sequence + 1,
+                                                   std::memory_order_acquire)) {
+        // The other thread is writing this slot.
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+}
+
+template <typename EvalResult>
+void Cache<EvalResult>::unlock_slot(Slot &slot, const std::uint32_t sequence) {
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+template <typename EvalResult>
+typename Cache<EvalResult>::Slot &Cache<EvalResult>::get_slot(const std::uint64_t hash,
+                                                              const size_t probe) {
+    return m_slots[(hash + probe) % m_slots.size()];
+}
+
 template <typename EvalResult>
 bool Cache<EvalResult>::lookup(std::uint64_t hash,
                                     EvalResult &result) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    bool success = true;
-    ++m_lookups;
-
-    const auto iter = m_cache.find(hash);
-    if (iter == m_cache.end()) {
-        success = false;
-    } else {
-        const auto &entry = iter->second;
-        ++m_hits;
-        result = entry->result;
-    }
-    return success;
+    m_lookups.fetch_add(1, std::memory_order_relaxed);
+    if (hash == EMPTY_HASH) {
+        return false;
+    }
+
+    for (auto p = size_t{0}; p < PROBE_SLOTS; ++p) {
+        auto &slot = get_slot(hash, p);
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if ((sequence & 1) != 0 ||
+                slot.hash.load(std::memory_order_relaxed) != hash) {
+            continue;
+        }
+
+        EvalResult buffer;
+        std::memcpy(&buffer, &slot.result, sizeof(EvalResult));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+            result = buffer;
+            slot.referenced.store(true, std::memory_order_relaxed);
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
 }
 
 template <typename EvalResult>
 void Cache<EvalResult>::insert(std::uint64_t hash,
                                     const EvalResult &result) {
+    if (hash == EMPTY_HASH) {
+        return;
+    }
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-
-    if (m_cache.find(hash) == m_cache.end()) {
-        m_cache.emplace(hash, std::make_unique<Entry>(result));
-        m_order.emplace_back(hash);
-        ++m_inserts;
-
-        if (m_order.size() > m_size) {
-            m_cache.erase(m_order.front());
-            m_order.pop_front();
+    // Take an empty slot first. Otherwise take the first slot which
+    // was not referenced since the last pass, and clear the reference
+    // bits we pass over.
+    Slot *victim = nullptr;
+    for (auto p = size_t{0}; p < PROBE_SLOTS; ++p) {
+        auto &slot = get_slot(hash, p);
+        const auto slot_hash = slot.hash.load(std::memory_order_relaxed);
+        if (slot_hash == hash) {
+            return;
+        }
+        if (slot_hash == EMPTY_HASH) {
+            victim = &slot;
+            break;
+        }
+        if (!victim &&
+                !slot.referenced.exchange(false, std::memory_order_relaxed)) {
+            victim = &slot;
         }
     }
+    if (!victim) {
+        victim = &get_slot(hash, 0);
+    }
+
+    auto sequence = std::uint32_t{0};
+    if (!lock_slot(*victim, sequence)) {
+        return;
+    }
+    victim->hash.store(hash, std::memory_order_relaxed);
+    std::memcpy(&victim->result, &result, sizeof(EvalResult));
+    victim->referenced.store(false, std::memory_order_relaxed);
+    unlock_slot(*victim, sequence);
+
+    m_inserts.fetch_add(1, std::memory_order_relaxed);
 }
 
 template <typename EvalResult>
 void Cache<EvalResult>::resize(size_t size) {
 
-    m_size = (size > Cache::MAX_CACHE_COUNT ? Cache::MAX_CACHE_COUNT : 
-              size < Cache::MIN_CACHE_COUNT ? Cache::MIN_CACHE_COUNT : size);
+    size = std::max(size, size_t{Cache::MIN_CACHE_COUNT});
+
+    if (size != m_slots.size()) {
+        std::vector<Slot>(size).swap(m_slots);
+    }
+}
+
+template <typename EvalResult>
+void Cache<EvalResult>::set_memory(int megabytes) {
+
+    megabytes = std::min(std::max(megabytes, MARCO_MINIMAL_CACHE_MEMORY_MB),
+                         MARCO_MAXIMAL_CACHE_MEMORY_MB);
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-    while (m_order.size() > m_size) {
-        m_cache.erase(m_order.front());
-        m_order.pop_front();
+    auto size = static_cast<size_t>(megabytes) * 1024 * 1024 / Cache::ENTRY_SIZE;
+    size = std::max(size, size_t{Cache::MIN_CACHE_COUNT});
+
+    if (size != m_slots.size()) {
+        std::vector<Slot>(size).swap(m_slots);
     }
 }
 
 template <typename EvalResult> 
 void Cache<EvalResult>::clear() {
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-    if (!m_order.empty()) {
-        m_cache.clear();
-        m_order.clear();
+    for (auto &slot : m_slots) {
+        if (slot.hash.load(std::memory_order_relaxed) == EMPTY_HASH) {
+            continue;
+        }
+        auto sequence = std::uint32_t{0};
+        while (!lock_slot(slot, sequence)) {}
+
+        slot.hash.store(EMPTY_HASH, std::memory_order_relaxed);
+        slot.referenced.store(false, std::memory_order_relaxed);
+        unlock_slot(slot, sequence);
     }
 }
 
 template <typename EvalResult>
 size_t Cache<EvalResult>::get_estimated_size() {
-    return m_order.size() * Cache::ENTRY_SIZE;
+    return m_slots.size() * Cache::ENTRY_SIZE;
 }
 
 template <typename EvalResult> 
 void Cache<EvalResult>::dump_stats() {
+    auto used = size_t{0};
+    for (const auto &slot : m_slots) {
+        if (slot.hash.load(std::memory_order_relaxed) != EMPTY_HASH) {
+            ++used;
+        }
+    }
+
+    const int hits = m_hits.load();
+    const int lookups = m_lookups.load();
     Utils::auto_printf("NNCache: %d/%d hits/lookups = %.1f%% hitrate, %d inserts, %lu size\n",
-                       m_hits, m_lookups, 100. * m_hits / (m_lookups + 1), m_inserts,
-                       m_cache.size());
+                       hits, lookups, 100. * hits / (lookups + 1), m_inserts.load(),
+                       used);
 }
 #endif
@@ -1,126 +1,169 @@
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
 #include "EndGameSearch.h"
 
-MaxminNode::MaxminNode(const int vertex) {
-    m_vertex = vertex;
-}
-
-bool MaxminNode::expend_children(GameState &state) {
-
-    assert(state.get_passes() < 2);
-    if (!m_children.empty()) {
-        return false;
+namespace {
+
+// The hash table of the solver. Every thread owns one, so it needs
+// no lock and the entries are kept across the searches.
+class SolverTable {
+public:
+    struct Entry {
+        Bitboard::MASK player;
+        Bitboard::MASK opponent;
+        std::int8_t lower;
+        std::int8_t upper;
+        std::int8_t best_bit;
+    };
+
+    static constexpr size_t TABLE_SIZE = 1 << 16;
+
+    void prepare(const Bitboard::MASK board_mask) {
+        if (m_entries.empty() || m_board_mask != board_mask) {
+            m_entries.assign(TABLE_SIZE, Entry{0ULL, 0ULL, 0, 0, -1});
+            m_board_mask = board_mask;
+        }
     }
 
-    const auto boardsize = state.get_boardsize();
-    const auto intersections = state.get_intersections();
-    m_color = state.get_to_move();
-
-    auto nodelist = std::vector<int>{};
-
-    for (int i = 0; i < intersections; ++i) {
-        const auto x = i % boardsize;
-        const auto y = i / boardsize;
-        const auto vertex = state.get_vertex(x, y);
-
-        if (state.is_legal(vertex, m_color)) {
-            nodelist.emplace_back(vertex);
+    const Entry *probe(const Bitboard::MASK player,
+                       const Bitboard::MASK opponent) const {
+        const auto &entry = m_entries[get_index(player, opponent)];
+        if (entry.player == player && entry.opponent == opponent) {
+            return &entry;
         }
+        return nullptr;
     }
 
-    if (nodelist.empty() && state.is_legal(Board::PASS, m_color)) {
-        nodelist.emplace_back(Board::PASS);
+    void store(const Bitboard::MASK player, const Bitboard::MASK opponent,
+               int lower, int upper, const int best_bit) {
+        auto &entry = m_entries[get_index(player, opponent)];
+        if (entry.player == player && entry.opponent == opponent) {
+            lower = std::max(lower, static_cast<int>(entry.lower));
+            upper = std::min(upper, static_cast<int>(entry.upper));
+        }
+        entry.player = player;
+        entry.opponent = opponent;
+        entry.lower = static_cast<std::int8_t>(lower);
+        entry.upper = static_cast<std::int8_t>(upper);
+        entry.best_bit = static_cast<std::int8_t>(best_bit);
     }
 
-    assert(!nodelist.empty());
-    for (const auto &v : nodelist) {
-        m_children.emplace_back(std::make_shared<MaxminNode>(v));
+private:
+    static size_t get_index(const Bitboard::MASK player,
+                            const Bitboard::MASK opponent) {
+        auto h = player * 0x9e3779b97f4a7c15ULL;
+        h ^= opponent * 0xc2b2ae3d27d4eb4fULL;
+        h ^= h >> 29;
+        return h & (TABLE_SIZE - 1);
     }
-    return true;
-}
 
-MaxminNode *MaxminNode::get_node() {
-    return this;
-}
+    std::vector<Entry> m_entries;
+    Bitboard::MASK m_board_mask{0ULL};
+};
 
-MaxminNode *MaxminNode::get_best_child() {
+thread_local SolverTable solver_table;
 
-    if (m_color == Board::INVAL) {
-        return nullptr;
-    }
+} // namespace
 
-    assert(m_best_vertex != -1);
-    auto best = m_children[0]->get_node();
+EndGameSearch::EndGameSearch(GameState &state, int exact_cnt, int wld_cnt) {
+    const auto num_empty = state.board.get_numempty();
+    if (num_empty <= exact_cnt) {
+        m_allow_search = true;
+    } else if (num_empty <= wld_cnt) {
+        m_allow_search = true;
+        m_wld = true;
+    }
 
-    for (const auto &child: m_children) {
-        auto vtx = child->get_vertex();
-        if (m_best_vertex == vtx) {
-            best = child->get_node();
-            break;
-        }
+    if (m_allow_search) {
+        m_rootstate = state;
     }
-    return best;
 }
 
-std::vector<std::shared_ptr<MaxminNode>>& MaxminNode::get_children() {
-    assert(m_color != Board::INVAL);
-    return m_children;
-}
+void EndGameSearch::init_board_masks() {
+    const auto boardsize = m_rootstate.get_boardsize();
+    const auto half = boardsize / 2;
 
-int MaxminNode::get_vertex() const {
-    return m_vertex;
-}
+    m_board_mask = Bitboard::board_mask(boardsize);
+    m_parity_regions.fill(0ULL);
 
-int MaxminNode::get_score(int color) const {
-    assert(color == Board::BLACK || color == Board::WHITE);
-    if (color == Board::BLACK) {
-        return m_black_score;
+    for (int y = 0; y < boardsize; ++y) {
+        for (int x = 0; x < boardsize; ++x) {
+            const auto region = (y < half ? 0 : 2) + (x < half ? 0 : 1);
+            m_parity_regions[region] |=
+                Bitboard::square(y * Bitboard::BITBOARD_WIDTH + x);
+        }
     }
-    return 0 - m_black_score;
 }
 
-bool MaxminNode::score_node(GameState &state) {
-
-    if (state.get_passes() < 2) {
-        return false;
-    }
-    assert(m_children.empty());
-    m_black_score = state.board.area_distance();
-    return true;
+EndGameSearch::MASK EndGameSearch::get_moves(MASK player, MASK opponent) const {
+    return Bitboard::get_moves(player, opponent) & m_board_mask;
 }
 
-void MaxminNode::set_score(const int score, const int color) {
-    assert(color == Board::BLACK || color == Board::WHITE);
-    if (color == Board::BLACK) {
-        m_black_score = score;
+EndGameSearch::MASK EndGameSearch::get_odd_regions(MASK empty) const {
+    auto res = MASK{0ULL};
+    for (const auto region : m_parity_regions) {
+        if (Bitboard::count(empty & region) & 1) {
+            res |= region;
+        }
     }
-    m_black_score = 0 - score;
-}
-
-void MaxminNode::set_bestvertex(const int vtx) {
-    m_best_vertex = vtx;
+    return res;
 }
 
-EndGameSearch::EndGameSearch(GameState &state, int empty_cnt) {
-    m_rootstate = state;
-
-    if (m_rootstate.board.get_numempty() <= empty_cnt) {
-        m_allow_search = true;
-    }
+int EndGameSearch::bit_to_vertex(int bit) const {
+    return m_rootstate.get_vertex(bit % Bitboard::BITBOARD_WIDTH,
+                                  bit / Bitboard::BITBOARD_WIDTH);
 }
 
 EndGameSearch::Result EndGameSearch::search() {
 
     assert(m_allow_search);
 
-    m_rootnode = new MaxminNode(Board::PASS);
-    
-    const auto score = loop(m_rootstate, m_rootnode);
-    const auto pv = get_pv(m_rootnode);
+    init_board_masks();
+    solver_table.prepare(m_board_mask);
+
+    const auto color = m_rootstate.get_to_move();
+    const auto snapshot = m_rootstate.board.get_snapshot();
+    const auto player = snapshot.bitboard[color];
+    const auto opponent = snapshot.bitboard[!color];
+    const auto passed = m_rootstate.get_passes() > 0;
+
+    if (m_wld) {
+        // The side to move wins if the score is greater than it.
+        const auto komi = m_rootstate.get_komi();
+        const auto threshold = color == Board::BLACK ? komi : -komi;
+        auto alpha = static_cast<int>(std::floor(threshold));
+        auto beta = static_cast<int>(std::ceil(threshold));
+        if (alpha == beta) {
+            alpha -= 1;
+            beta += 1;
+        }
+
+        // The score is only a bound, and the ownership is the current
+        // discs since there is no principal variation.
+        const auto score = alphabeta(player, opponent, alpha, beta, passed);
+        const auto ownership = m_rootstate.board.get_ownership();
+        m_pv.clear();
+
+        auto result = Result{};
+        result.ownership.fill(Board::INVAL);
+        std::copy(std::begin(ownership), std::end(ownership),
+                  std::begin(result.ownership));
+        result.score = color == Board::WHITE ? -score : score;
+        result.score_with_komi = static_cast<float>(result.score) - komi;
+        result.wld = true;
+
+        return result;
+    }
+
+    const auto score = alphabeta(player, opponent,
+                                 -MAX_SCORE, MAX_SCORE, passed);
+    build_pv(player, opponent, score, passed);
 
     auto state = std::make_shared<GameState>(m_rootstate);
-    for (const auto &v: pv) {
-        state->play_move(v);
+    for (const auto &v: m_pv) {
+        state->do_move(v);
     }
 
     assert(state->get_passes() == 2);
@@ -128,68 +171,246 @@ EndGameSearch::Result EndGameSearch::search() {
     const auto ownership = state->board.get_ownership();
 
     auto result = Result{};
-    result.ownership = ownership;
+    result.ownership.fill(Board::INVAL);
+    std::copy(std::begin(ownership), std::end(ownership),
+              std::begin(result.ownership));
     result.score_with_komi = score_with_komi;
     result.score = score;
+    result.wld = false;
 
-    if (m_rootstate.get_to_move() == Board::WHITE) {
+    if (color == Board::WHITE) {
         result.score = 0 - result.score;
     }
 
-    delete m_rootnode;
     return result;
 }
 
-int EndGameSearch::loop(GameState &current_state, MaxminNode *current_node) {
+int EndGameSearch::alphabeta(MASK player, MASK opponent,
+                             int alpha, int beta, bool passed) {
+
+    const auto empty = ~(player | opponent) & m_board_mask;
+    const auto num_empty = Bitboard::count(empty);
+
+    if (num_empty <= SMALL_EMPTIES) {
+        return solve_small(player, opponent, empty, alpha, beta, passed);
+    }
+
+    const auto moves = get_moves(player, opponent);
+    if (moves == 0ULL) {
+        if (passed) {
+            return Bitboard::count(player) - Bitboard::count(opponent);
+        }
+        return -alphabeta(opponent, player, -beta, -alpha, true);
+    }
 
-    if (current_node->score_node(current_state)) {
-        const auto color = current_state.get_to_move();
-        const auto score = current_node->get_score(color);
-        return score;
+    const auto use_hash = num_empty >= HASH_EMPTIES;
+    auto hash_bit = -1;
+    if (use_hash) {
+        if (const auto entry = solver_table.probe(player, opponent)) {
+            if (entry->lower >= beta) {
+                return entry->lower;
+            }
+            if (entry->upper <= alpha) {
+                return entry->upper;
+            }
+            if (entry->lower == entry->upper) {
+                return entry->lower;
+            }
+            alpha = std::max(alpha, static_cast<int>(entry->lower));
+            beta = std::min(beta, static_cast<int>(entry->upper));
+            hash_bit = entry->best_bit;
+        }
     }
 
-    const auto intersections = current_state.get_intersections();
+    struct MoveOrder {
+        int bit;
+        MASK flips;
+        int key;
+    };
+
+    // The hash move first, then the fastest-first (less opponent
+    // mobility) and the moves in the odd regions.
+    auto movelist = std::array<MoveOrder, NUM_INTERSECTIONS>{};
+    auto num_moves = 0;
+    const auto odd_regions = get_odd_regions(empty);
+
+    auto remain = moves;
+    while (remain) {
+        const auto bit = Bitboard::lowest(remain);
+        const auto square = Bitboard::square(bit);
+        const auto flips = Bitboard::get_flips(bit, player, opponent);
+        const auto mobility = Bitboard::count(get_moves(opponent & ~flips,
+                                                        player | flips | square));
+        auto key = -16 * mobility;
+        if (odd_regions & square) {
+            key += 8;
+        }
+        if (bit == hash_bit) {
+            key += 1 << 16;
+        }
+        movelist[num_moves++] = MoveOrder{bit, flips, key};
+        remain = Bitboard::pop_lowest(remain);
+    }
 
-    auto best_score = 0 - intersections;
-    auto success = current_node->expend_children(current_state);
-    assert(success);
+    std::sort(std::begin(movelist), std::begin(movelist) + num_moves,
+              [](const MoveOrder &a, const MoveOrder &b) { return a.key > b.key; });
+
+    const auto alpha_ori = alpha;
+    auto best_score = -MAX_SCORE;
+    auto best_bit = -1;
+
+    for (int i = 0; i < num_moves; ++i) {
+        const auto &move = movelist[i];
+        const auto next_player = opponent & ~move.flips;
+        const auto next_opponent = player | move.flips | Bitboard::square(move.bit);
+
+        auto score = 0;
+        if (i == 0) {
+            score = -alphabeta(next_player, next_opponent, -beta, -alpha, false);
+        } else {
+            // Null window search first. Search again if the move is better.
+            score = -alphabeta(next_player, next_opponent, -alpha - 1, -alpha, false);
+            if (score > alpha && score < beta) {
+                score = -alphabeta(next_player, next_opponent, -beta, -alpha, false);
+            }
+        }
 
-    auto children = current_node->get_children();
-    for (auto &child: children) {
-        auto next_state = current_state;
-        auto vtx = child->get_vertex();
-        next_state.play_move(vtx);
-        auto next_score = 0 - loop(next_state, child->get_node());
-        if (next_score > best_score) {
-            best_score = next_score;
-            current_node->set_bestvertex(vtx);
+        if (score > best_score) {
+            best_score = score;
+            best_bit = move.bit;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) {
+                    break;
+                }
+            }
         }
     }
 
-    const auto color = current_state.get_to_move();
-    current_node->set_score(best_score, color);
+    if (use_hash) {
+        const auto lower = best_score > alpha_ori ? best_score : -MAX_SCORE;
+        const auto upper = best_score < beta ? best_score : MAX_SCORE;
+        solver_table.store(player, opponent, lower, upper, best_bit);
+    }
 
     return best_score;
 }
 
-bool EndGameSearch::valid() const {
-    return m_allow_search;
+int EndGameSearch::solve_small(MASK player, MASK opponent, MASK empty,
+                               int alpha, int beta, bool passed) {
+
+    if (empty && !Bitboard::pop_lowest(empty)) {
+        return solve_last(player, opponent, Bitboard::lowest(empty));
+    }
+
+    const auto odd_regions = get_odd_regions(empty);
+    auto best_score = -MAX_SCORE;
+    auto moved = false;
+
+    // Try the empties in the odd regions first.
+    for (const auto candidates : {empty & odd_regions, empty & ~odd_regions}) {
+        auto remain = candidates;
+        while (remain) {
+            const auto bit = Bitboard::lowest(remain);
+            remain = Bitboard::pop_lowest(remain);
+
+            const auto flips = Bitboard::get_flips(bit, player, opponent);
+            if (!flips) {
+                continue;
+            }
+            moved = true;
+
+            const auto square = Bitboard::square(bit);
+            const auto score = -solve_small(opponent & ~flips, player | flips | square,
+                                            empty & ~square, -beta, -alpha, false);
+            if (score > best_score) {
+                best_score = score;
+                if (score > alpha) {
+                    alpha = score;
+                    if (alpha >= beta) {
+                        return best_score;
+                    }
+                }
+            }
+        }
+    }
+
+    if (!moved) {
+        if (passed) {
+            return Bitboard::count(player) - Bitboard::count(opponent);
+        }
+        return -solve_small(opponent, player, empty, -beta, -alpha, true);
+    }
+    return best_score;
 }
 
-std::vector<int> EndGameSearch::get_pv(MaxminNode *root) {
+int EndGameSearch::solve_last(MASK player, MASK opponent, int bit) const {
 
-    auto res = std::vector<int>{};
-    if (!m_rootnode) {
-        return res;
+    const auto player_discs = Bitboard::count(player);
+    const auto opponent_discs = Bitboard::count(opponent);
+
+    auto flips = Bitboard::count(Bitboard::get_flips(bit, player, opponent));
+    if (flips) {
+        return (player_discs + flips + 1) - (opponent_discs - flips);
     }
 
-    auto current_node = root->get_best_child();
-    while (current_node) {
-        const auto vtx = current_node->get_vertex();
-        res.emplace_back(vtx);
-        current_node = current_node->get_best_child();
+    flips = Bitboard::count(Bitboard::get_flips(bit, opponent, player));
+    if (flips) {
+        return (player_discs - flips) - (opponent_discs + flips + 1);
     }
-    return res;
+
+    return player_discs - opponent_discs;
+}
+
+void EndGameSearch::build_pv(MASK player, MASK opponent, int score, bool passed) {
+
+    // Walk down the moves which keep the score. Every step is a narrow
+    // window search and most of them hit the hash table.
+    m_pv.clear();
+    while (true) {
+        const auto moves = get_moves(player, opponent);
+        if (moves == 0ULL) {
+            m_pv.emplace_back(Board::PASS);
+            if (passed) {
+                break;
+            }
+            passed = true;
+            std::swap(player, opponent);
+            score = -score;
+            continue;
+        }
+        passed = false;
+
+        auto remain = moves;
+        auto found = false;
+        while (remain) {
+            const auto bit = Bitboard::lowest(remain);
+            const auto flips = Bitboard::get_flips(bit, player, opponent);
+            const auto next_player = opponent & ~flips;
+            const auto next_opponent = player | flips | Bitboard::square(bit);
+            const auto next_score = -alphabeta(next_player, next_opponent,
+                                               -score - 1, -score + 1, false);
+            if (next_score == score) {
+                m_pv.emplace_back(bit_to_vertex(bit));
+                player = next_player;
+                opponent = next_opponent;
+                score = -score;
+                found = true;
+                break;
+            }
+            remain = Bitboard::pop_lowest(remain);
+        }
+        assert(found);
+        (void) found;
+    }
+}
+
+bool EndGameSearch::valid() const {
+    return m_allow_search;
+}
+
+bool EndGameSearch::is_wld() const {
+    return m_wld;
 }
 
 void EndGameCache::resize(const int cache_size) {
@@ -200,12 +421,32 @@ void EndGameCache::clear() {
     m_cache.clear();
 }
 
-bool EndGameCache::prob_cache(const GameState *const state,
+std::uint64_t EndGameCache::get_key(const GameState *const state, const bool wld) {
+    static constexpr auto WLD_KEY = 0x5bd1e9955bd1e995ULL;
+    const auto hash = state->board.get_hash();
+    return wld ? hash ^ WLD_KEY : hash;
+}
+
+bool EndGameCache::prob_cache(const GameState *const state, const bool wld,
                               EndGameSearch::Result &result) {
-    return m_cache.lookup(state->board.get_hash(), result);
+    return m_cache.lookup(get_key(state, wld), result);
 }
 
 void EndGameCache::insert_cache(const GameState *const state,
                                 EndGameSearch::Result &result) {
-    m_cache.insert(state->board.get_hash(), result);
+    m_cache.insert(get_key(state, result.wld), result);
+}
+
+bool EndGameCache::acquire_pending(const GameState *const state, const bool wld,
+                                   const size_t max_pending) {
+    std::lock_guard<std::mutex> lock(m_pending_mutex);
+    if (m_pending.size() >= max_pending) {
+        return false;
+    }
+    return m_pending.insert(get_key(state, wld)).second;
+}
+
+void EndGameCache::release_pending(const GameState *const state, const bool wld) {
+    std::lock_guard<std::mutex> lock(m_pending_mutex);
+    m_pending.erase(get_key(state, wld));
 }
@@ -1,65 +1,114 @@
+#ifndef ENDGAMESEARCH_H_INCLUDE
+#define ENDGAMESEARCH_H_INCLUDE
+
+#include <array>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <unordered_set>
+#include "Bitboard.h"
 #include "Cache.h"
 #include "Board.h"
-#include "GameState.h" 
-
-class MaxminNode {
-public:
-    MaxminNode(const int vertex);
-    bool expend_children(GameState &state);
-
-    MaxminNode *get_node();
-    MaxminNode *get_best_child();
-
-    std::vector<std::shared_ptr<MaxminNode>>& get_children();
-
-    int get_vertex() const;
-    int get_score(int color) const;
-
-    bool score_node(GameState &state);
-    void set_score(const int score, const int color);
-    void set_bestvertex(const int vtx);
-
-private:
-    std::vector<std::shared_ptr<MaxminNode>> m_children;
-    int m_vertex;
-    int m_color{Board::INVAL};
-
-    int m_black_score{0};
-    int m_best_vertex{-1};
-};
+#include "GameState.h"
 
+/*
+ * The exact end-game solver. It is the alpha-beta (PVS) search on the
+ * bitboards with the fastest-first and parity move ordering. The scores
+ * are the disc difference from the side to move.
+ *
+ * The positions with a few more empties may be solved in the WLD mode. It
+ * is a null window search around the komi, so it only tells the win, the
+ * draw and the loss apart.
+ */
 class EndGameSearch {
 public:
     struct Result {
-        std::vector<int> ownership;
+        std::array<int, NUM_INTERSECTIONS> ownership;
         float score_with_komi;
         int score;
+        // The WLD result only tells the winner. Its score is a bound and
+        // its ownership is the current discs.
+        bool wld;
     };
 
-    EndGameSearch(GameState &state, int empty_cnt);
+    // Solve the exact score if the empties are not more than exact_cnt,
+    // or the win/draw/loss if they are not more than wld_cnt.
+    EndGameSearch(GameState &state, int exact_cnt, int wld_cnt = 0);
 
     Result search();
 
     bool valid() const;
 
-    std::vector<int> get_pv(MaxminNode *root);
+    bool is_wld() const;
 
 private:
-    int loop(GameState &current_state, MaxminNode *current_node);
+    using MASK = Bitboard::MASK;
+
+    static constexpr int MAX_SCORE = NUM_INTERSECTIONS + 1;
+
+    // Use the special routines if the empties are not more than it.
+    static constexpr int SMALL_EMPTIES = 4;
+
+    // Don't probe the hash table below it.
+    static constexpr int HASH_EMPTIES = 6;
+
+    int alphabeta(MASK player, MASK opponent,
+                  int alpha, int beta, bool passed);
+
+    int solve_small(MASK player, MASK opponent, MASK empty,
+                    int alpha, int beta, bool passed);
+
+    int solve_last(MASK player, MASK opponent, int bit) const;
+
+    MASK get_moves(MASK player, MASK opponent) const;
+
+    MASK get_odd_regions(MASK empty) const;
+
+    int bit_to_vertex(int bit) const;
+
+    void init_board_masks();
+
+    // Play out the principal variation, so the final position gives the
+    // score with komi and the ownership. It ends with two passes.
+    void build_pv(MASK player, MASK opponent, int score, bool passed);
 
     GameState m_rootstate;
-    MaxminNode *m_rootnode{nullptr};
+
+    MASK m_board_mask;
+    std::array<MASK, 4> m_parity_regions;
+
+    std::vector<int> m_pv;
     bool m_allow_search{false};
+    bool m_wld{false};
 };
 
 struct EndGameCache {
     Cache<EndGameSearch::Result> m_cache;
+
+    // The positions queued to the solver threads but not solved yet. Only
+    // the tasks remove them, so a position is never queued twice.
+    std::unordered_set<std::uint64_t> m_pending;
+    std::mutex m_pending_mutex;
+
     void resize(const int cache_size);
+    // Clear the results. The pending positions stay, since their tasks
+    // may still be queued.
     void clear();
-    bool prob_cache(const GameState *const state,
+    // The WLD results are stored apart from the exact ones, so the exact
+    // probe never gets a bound.
+    bool prob_cache(const GameState *const state, const bool wld,
                     EndGameSearch::Result &result);
     void insert_cache(const GameState *const state,
                       EndGameSearch::Result &result);
+
+    // Return false if the position is already pending, or if the pending
+    // positions are as many as max_pending.
+    bool acquire_pending(const GameState *const state, const bool wld,
+                         const size_t max_pending);
+    void release_pending(const GameState *const state, const bool wld);
+
+private:
+    static std::uint64_t get_key(const GameState *const state, const bool wld);
 };
+
+#endif
@@ -24,7 +24,7 @@ void Engine::initialize() {
 
 
     m_evaluation = std::make_shared<Evaluation>();
-    m_evaluation->initialize_network(option<int>("playouts"), option<std::string>("weights_file"));
+    m_evaluation->initialize_network(option<std::string>("weights_file"));
 
     m_trainer = std::make_shared<Trainer>();
     m_search = std::make_shared<Search>(*m_state, *m_evaluation, *m_trainer);
@@ -173,8 +173,8 @@ Engine::Response Engine::dump_sgf(std::string file) {
     return out.str();
 }
 
-Engine::Response Engine::set_playouts(const int p) {
-    m_evaluation->set_playouts(p);
+Engine::Response Engine::set_cache_memory(const int megabytes) {
+    m_evaluation->set_cache_memory(megabytes);
     return Response{};
 }
 
@@ -202,6 +202,25 @@ Engine::Response Engine::nn_batchmark(const int times) {
     return out.str();
 }
 
+Engine::Response Engine::uct_benchmark(const int playouts) {
+
+    auto out = std::ostringstream{};
+    const auto speed_list = m_search->uct_benchmark(playouts);
+    const auto base_speed = speed_list[0].second;
+
+    out << "Playouts : " << playouts << " | ";
+    out << "Leaf batch : " << option<int>("leaf_batch") << std::endl;
+    for (const auto &speed : speed_list) {
+        out << "Threads : " << speed.first << " | ";
+        out << "Speed : " << speed.second << " playouts/second" << " | ";
+        out << "Scaling : " << speed.second / base_speed;
+        if (&speed != &speed_list.back()) {
+            out << std::endl;
+        }
+    }
+    return out.str();
+}
+
 Engine::Response Engine::clear_cache() {
     m_evaluation->clear_cache();
     return Response{};
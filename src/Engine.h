@@ -44,7 +44,7 @@ public:
 
     Response dump_sgf(std::string file = "std-output");
 
-    Response set_playouts(const int p);
+    Response set_cache_memory(const int megabytes);
  
     Response clear_board();
 
@@ -52,6 +52,8 @@ public:
 
     Response nn_batchmark(const int times);
 
+    Response uct_benchmark(const int playouts);
+
     Response clear_cache();
 
     Response random_playmove();
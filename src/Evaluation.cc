@@ -9,9 +9,8 @@
 #include <memory>
 #include <numeric>
 
-void Evaluation::initialize_network(int playouts,
-                                    const std::string &weightsfile) {
-    m_network.initialize(playouts, weightsfile);
+void Evaluation::initialize_network(const std::string &weightsfile) {
+    m_network.initialize(weightsfile);
 }
 
 Evaluation::NNeval Evaluation::network_eval(GameState &state,
@@ -19,6 +18,12 @@ Evaluation::NNeval Evaluation::network_eval(GameState &state,
     return m_network.get_output(&state, ensemble);
 }
 
+void Evaluation::network_eval_batch(const std::vector<const Position *> &states,
+                                    std::vector<NNeval> &evals,
+                                    Network::BatchBuffer &buffer) {
+    m_network.get_output_batch(states, evals, buffer);
+}
+
 void Evaluation::reload_network(std::string &weightsfile) {
     m_network.reload_weights(weightsfile);
 }
@@ -31,8 +36,12 @@ void Evaluation::release_nn() {
     m_network.release_nn();
 }
 
-void Evaluation::set_playouts(const int p) {
-    m_network.set_playouts(p);
+void Evaluation::set_cache_memory(const int megabytes) {
+    m_network.set_cache_memory(megabytes);
+}
+
+void Evaluation::dump_batch_stats() {
+    m_network.dump_batch_stats();
 }
 
 float Evaluation::nn_benchmark(GameState &state, const int times) {
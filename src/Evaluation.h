@@ -15,17 +15,25 @@ class Evaluation {
 public:
     using NNeval = NNResult;
 
-    void initialize_network(int playouts, const std::string &weightsfile);
+    void initialize_network(const std::string &weightsfile);
     NNeval network_eval(GameState &state,
                         Network::Ensemble ensemble = Network::RANDOM_SYMMETRY);
 
+    // Evaluate the positions in one call with the random symmetries. The
+    // buffer belongs to the calling thread.
+    void network_eval_batch(const std::vector<const Position *> &states,
+                            std::vector<NNeval> &evals,
+                            Network::BatchBuffer &buffer);
+
     void reload_network(std::string &weightsfile);
 
     void clear_cache();
 
     void release_nn();
 
-    void set_playouts(const int p);
+    void set_cache_memory(const int megabytes);
+
+    void dump_batch_stats();
 
     float nn_benchmark(GameState &state, const int times);
 
@@ -13,8 +13,7 @@ void GameState::init_game(int size, float komi) {
 
     reset_time();
 
-    m_game_history.clear();
-    m_game_history.emplace_back(std::make_shared<Board>(board));
+    m_game_history[0] = board.get_snapshot();
 
 
     m_resigned = Board::INVAL;
@@ -35,27 +34,45 @@ bool GameState::play_move(const int vtx, const int color) {
         m_resigned = color;
         return true;
     } else {
-        board.play_move(vtx, color);
+        do_move(vtx, color);
     }
 
-    const auto movenum = board.get_movenum();
-    assert((unsigned)movenum == m_game_history.size());
+    return true;
+}
 
-    m_game_history.emplace_back(std::make_shared<Board>(board));
-    m_game_history.resize(movenum + 1);
+void GameState::do_move(const int vtx) {
+    do_move(vtx, board.get_to_move());
+}
 
-    return true;
+void GameState::do_move(const int vtx, const int color) {
+
+    assert(vtx != Board::RESIGN);
+    assert(board.get_movenum() < MAX_MOVES);
+
+    board.do_move(vtx, color, m_move_records[board.get_movenum()]);
+
+    const auto movenum = board.get_movenum();
+    m_game_history[movenum % HISTORY_SIZE] = board.get_snapshot();
 }
 
 bool GameState::undo_move() {
 
     const auto movenum = board.get_movenum();
-    if (movenum > 0) {
-        board = *m_game_history[movenum - 1];
-        m_game_history.resize(movenum);
-        return true;
+    if (movenum == 0) {
+        return false;
     }
-    return false;
+
+    board.undo_move(m_move_records[movenum - 1]);
+
+    // The oldest position was dropped from the history when this
+    // move was played. Take it back from the position after it.
+    const auto oldest = movenum - HISTORY_SIZE;
+    if (oldest >= 0) {
+        auto snapshot = m_game_history[(oldest + 1) % HISTORY_SIZE];
+        snapshot.undo_move(m_move_records[oldest]);
+        m_game_history[oldest % HISTORY_SIZE] = snapshot;
+    }
+    return true;
 }
 
 bool GameState::play_textmove(std::string input) {
@@ -173,10 +190,10 @@ std::string GameState::get_sgf_string() const {
 
     std::ostringstream out;
     const int movenum = board.get_movenum();
-    for (int p = 1; p <= movenum; ++p) {
+    for (int p = 0; p < movenum; ++p) {
         out << ";";
-        auto past_board = m_game_history[p];
-        past_board->sgf_stream(out);
+        const auto &record = m_move_records[p];
+        board.sgf_stream(out, record.vertex, record.color);
     }
     return out.str();
 }
@@ -265,11 +282,11 @@ std::string GameState::result_to_string() {
     return out.str();
 }
 
-const std::shared_ptr<Board> GameState::get_past_board(int moves_ago) const {
+const Board::Snapshot &Position::get_past_board(int moves_ago) const {
     const auto movenum = board.get_movenum();
     assert(moves_ago >= 0 && moves_ago <= movenum);
-    assert((unsigned)movenum + 1 <= m_game_history.size());
-    return m_game_history[movenum - moves_ago];
+    assert(moves_ago < HISTORY_SIZE);
+    return m_game_history[(movenum - moves_ago) % HISTORY_SIZE];
 }
 
 bool GameState::superko() const {
@@ -310,15 +327,20 @@ bool GameState::is_legal(const int vtx,
     return board.is_legal(vtx, color);
 }
 
-int GameState::get_movenum() const {
+const Board::MoveRecord &GameState::get_move_record(const int movenum) const {
+    assert(movenum >= 0 && movenum < board.get_movenum());
+    return m_move_records[movenum];
+}
+
+int Position::get_movenum() const {
     return board.get_movenum();
 }
 
-int GameState::get_passes() const {
+int Position::get_passes() const {
     return board.get_passes();
 }
 
-float GameState::get_komi() const {
+float Position::get_komi() const {
     return board.get_komi();
 }
 
@@ -326,6 +348,6 @@ void GameState::set_komi(const float komi) {
     board.set_komi(komi);
 }
 
-int GameState::get_last_move() const {
+int Position::get_last_move() const {
     return board.get_last_move();
 }
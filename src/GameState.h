@@ -1,6 +1,7 @@
 #ifndef GAMESTATE_H_INCLUDE
 #define GAMESTATE_H_INCLUDE
 
+#include <array>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -10,8 +11,44 @@
 #include "TimeControl.h"
 #include "Board.h"
 
-class GameState {
+// The board and its recent history. It is all the network and the
+// expansion of a node read, so the search may keep it apart from the
+// whole game.
+class Position {
 public:
+    // The network looks back at most 10 positions. It should
+    // be the power of 2.
+    static constexpr int HISTORY_SIZE = 16;
+
+    Board board;
+
+    const Board::Snapshot &get_past_board(int moves_ago) const;
+
+    int get_x(const int vtx) const;
+    int get_y(const int vtx) const;
+    std::pair<int, int> get_xy(const int vtx) const;
+
+    int get_boardsize() const;
+    int get_to_move() const;
+    int get_last_move() const;
+    int get_intersections() const;
+    int get_movenum() const;
+    int get_vertex(const int x, const int y) const;
+    int get_index(const int x, const int y) const;
+    int get_passes() const;
+    float get_komi() const;
+
+protected:
+    // The last HISTORY_SIZE positions, indexed by the move number.
+    std::array<Board::Snapshot, HISTORY_SIZE> m_game_history;
+};
+
+class GameState : public Position {
+public:
+    // Each move fills one square and there are never two passes
+    // in a row before the game is over.
+    static constexpr int MAX_MOVES = 2 * NUM_INTERSECTIONS + 2;
+
     GameState() = default;
 
     void init_game(int size, float komi);
@@ -21,14 +58,18 @@ public:
     bool play_move(const int vtx, const int color);
     bool undo_move();
 
+    // Play the move without legality checking. It is taken back
+    // by undo_move(). Used by the search on its own copy of the state.
+    void do_move(const int vtx);
+    void do_move(const int vtx, const int color);
+
     void display(const size_t strip = 0) const;
     std::string display_to_string(const size_t strip = 0) const;
     std::string vertex_to_string(int vertex) const;
 
     bool play_textmove(std::string input);
-    const std::shared_ptr<Board> get_past_board(int moves_ago) const;
-
-    Board board;
+    // The record of the move played at the move number.
+    const Board::MoveRecord &get_move_record(const int movenum) const;
 
     void set_to_move(int color);
 
@@ -55,57 +96,45 @@ public:
     bool is_legal(const int vtx,
                   const int color) const;
 
-    int get_x(const int vtx) const;
-    int get_y(const int vtx) const;
-    std::pair<int, int> get_xy(const int vtx) const;
-
-    int get_boardsize() const;
-    int get_to_move() const;
-    int get_last_move() const;
-    int get_intersections() const;
-    int get_movenum() const;
-    int get_vertex(const int x, const int y) const;
-    int get_index(const int x, const int y) const;
-    int get_passes() const;
-    float get_komi() const;
     void set_komi(const float komi);
 
 private:
     TimeControl m_time_control;
 
-    std::vector<std::shared_ptr<Board>> m_game_history;
+    // All moves of the game. Used by undo_move() and the SGF.
+    std::array<Board::MoveRecord, MAX_MOVES> m_move_records;
     int m_resigned;
 };
 
-inline int GameState::get_boardsize() const {
+inline int Position::get_boardsize() const {
     return board.get_boardsize();
 }
 
-inline int GameState::get_intersections() const {
+inline int Position::get_intersections() const {
     return board.get_intersections();
 }
 
-inline int GameState::get_to_move() const {
+inline int Position::get_to_move() const {
     return board.get_to_move();
 }
 
-inline int GameState::get_x(const int vtx) const {
+inline int Position::get_x(const int vtx) const {
     return board.get_x(vtx);
 }
 
-inline int GameState::get_y(const int vtx) const {
+inline int Position::get_y(const int vtx) const {
     return board.get_y(vtx);
 }
 
-inline std::pair<int, int> GameState::get_xy(const int vtx) const {
+inline std::pair<int, int> Position::get_xy(const int vtx) const {
     return board.get_xy(vtx);
 }
 
-inline int GameState::get_vertex(const int x, const int y) const {
+inline int Position::get_vertex(const int x, const int y) const {
     return board.get_vertex(x, y);
 }
 
-inline int GameState:: get_index(const int x, const int y) const {
+inline int Position:: get_index(const int x, const int y) const {
     return board.get_index(x, y);
 }
 
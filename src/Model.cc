@@ -4,6 +4,7 @@
 #include "Random.h"
 #include "config.h"
 
+#include <algorithm>
 #include <iterator>
 #include <iomanip>
 #include <functional>
@@ -18,6 +19,25 @@ void process_bn_var(container &weights) {
     }
 }
 
+// The normalization is stddev * (conv - mean), so the stddev scales the
+// weights of each output channel and -stddev * mean is the bias.
+void fold_batchnorm(Desc::ConvLayer &conv, Desc::BatchNormLayer &bn) {
+    const auto outputs = bn.means.size();
+    const auto filter_size = conv.weights.size() / outputs;
+    assert(filter_size * outputs == conv.weights.size());
+
+    conv.biases.resize(outputs);
+    for (auto o = size_t{0}; o < outputs; ++o) {
+        const auto begin = std::begin(conv.weights) + o * filter_size;
+        std::for_each(begin, begin + filter_size,
+                      [&](auto &w) { w *= bn.stddevs[o]; });
+        conv.biases[o] = -bn.stddevs[o] * bn.means[o];
+    }
+
+    bn.means.clear();
+    bn.stddevs.clear();
+}
+
 void Desc::ConvLayer::load_weights(std::vector<float> &loadweights) {
     weights = std::move(loadweights);
 }
@@ -159,20 +179,21 @@ void Model::fill_weights(std::istream &weights_file,
     nn_weight->loaded = true;
 }
 
-void fill_color_plane_pair(const std::shared_ptr<Board> board,
+void fill_color_plane_pair(const Board &board,
+                           const Board::Snapshot &snapshot,
                            std::vector<float>::iterator black,
                            std::vector<float>::iterator white,
                            const int symmetry) {
 
-    const auto boardsize = board->get_boardsize();
-    const auto intersections = board->get_intersections();
+    const auto boardsize = board.get_boardsize();
+    const auto intersections = board.get_intersections();
 
     for (int idx = 0; idx < intersections; ++idx) {
         const auto sym_idx = Board::symmetry_nn_idx_table[symmetry][idx];
         const auto x = sym_idx % boardsize;
         const auto y = sym_idx / boardsize;
-        const auto vtx = board->get_vertex(x, y);
-        const auto color = board->get_state(vtx);
+        const auto vtx = board.get_vertex(x, y);
+        const auto color = snapshot.get_state(vtx);
         if (color == Board::BLACK) {
             black[idx] = static_cast<float>(true);
         } else if (color == Board::WHITE) {
@@ -181,21 +202,21 @@ void fill_color_plane_pair(const std::shared_ptr<Board> board,
     }
 }
 
-void fill_side_plane_pair(const std::shared_ptr<Board> board,
+void fill_side_plane_pair(const Board &board,
                           std::vector<float>::iterator black,
                           std::vector<float>::iterator white,
                           const int symmetry) {
 
-    const auto boardsize = board->get_boardsize();
-    const auto intersections = board->get_intersections();
+    const auto boardsize = board.get_boardsize();
+    const auto intersections = board.get_intersections();
 
     for (int idx = 0; idx < intersections; ++idx) {
         const auto sym_idx = Board::symmetry_nn_idx_table[symmetry][idx];
         const auto x = sym_idx % boardsize;
         const auto y = sym_idx / boardsize;
-        const auto vtx = board->get_vertex(x, y);
-        const auto color = board->get_state(vtx);
-        if (board->is_side(vtx)) {
+        const auto vtx = board.get_vertex(x, y);
+        const auto color = board.get_state(vtx);
+        if (board.is_side(vtx)) {
             if (color == Board::BLACK) {
                 black[idx] = static_cast<float>(true);
             } else if (color == Board::WHITE) {
@@ -206,21 +227,21 @@ void fill_side_plane_pair(const std::shared_ptr<Board> board,
 }
 
 
-void fill_corner_plane_pair(const std::shared_ptr<Board> board,
+void fill_corner_plane_pair(const Board &board,
                             std::vector<float>::iterator black,
                             std::vector<float>::iterator white,
                             const int symmetry) {
 
-    const auto boardsize = board->get_boardsize();
-    const auto intersections = board->get_intersections();
+    const auto boardsize = board.get_boardsize();
+    const auto intersections = board.get_intersections();
 
     for (int idx = 0; idx < intersections; ++idx) {
         const auto sym_idx = Board::symmetry_nn_idx_table[symmetry][idx];
         const auto x = sym_idx % boardsize;
         const auto y = sym_idx / boardsize;
-        const auto vtx = board->get_vertex(x, y);
-        const auto color = board->get_state(vtx);
-        if (board->is_corner(vtx)) {
+        const auto vtx = board.get_vertex(x, y);
+        const auto color = board.get_state(vtx);
+        if (board.is_corner(vtx)) {
             if (color == Board::BLACK) {
                 black[idx] = static_cast<float>(true);
             } else if (color == Board::WHITE) {
@@ -230,18 +251,19 @@ void fill_corner_plane_pair(const std::shared_ptr<Board> board,
     }
 }
 
-void fill_move_plane(const std::shared_ptr<Board> board,
+void fill_move_plane(const Board &board,
+                     const Board::Snapshot &snapshot,
                      std::vector<float>::iterator plane,
                      const int symmetry) {
 
-    const int last_move = board->get_last_move();
+    const int last_move = snapshot.lastmove;
     if (last_move == Board::NO_VERTEX || last_move == Board::PASS || last_move == Board::RESIGN) {
         return;
     }
-    const auto intersections = board->get_intersections();
-    const int x = board->get_x(last_move);
-    const int y = board->get_y(last_move);
-    const int lastmove_idx = board->get_index(x, y);
+    const auto intersections = board.get_intersections();
+    const int x = board.get_x(last_move);
+    const int y = board.get_y(last_move);
+    const int lastmove_idx = board.get_index(x, y);
 
     for (int idx = 0; idx < intersections; ++idx) {
         const auto sym_idx = Board::symmetry_nn_idx_table[symmetry][idx];
@@ -252,23 +274,21 @@ void fill_move_plane(const std::shared_ptr<Board> board,
     }
 }
 
-void fill_special_moves_planes(const std::shared_ptr<Board> board,
+void fill_special_moves_planes(const Board &board,
                                std::vector<float>::iterator plane,
                                const int symmetry) {
 
-    const auto intersections = board->get_intersections();
-    const auto color = board->get_to_move();
-    const auto movelist = board->get_movelist(color);
+    const auto intersections = board.get_intersections();
+    const auto color = board.get_to_move();
 
-    for (const auto &vtx : movelist) {
-        if (vtx == Board::PASS) {
-            return;
-        }
-        const int x = board->get_x(vtx);
-        const int y = board->get_y(vtx);
-        const int legalmove_idx = board->get_index(x, y);
+    // Walk the legal moves on the bitboard, so no move list is allocated.
+    for (auto moves = board.get_legal_moves(color); moves; moves = Bitboard::pop_lowest(moves)) {
+        const auto vtx = Board::bit_to_vertex(Bitboard::lowest(moves));
+        const int x = board.get_x(vtx);
+        const int y = board.get_y(vtx);
+        const int legalmove_idx = board.get_index(x, y);
 
-        if (board->is_side(vtx)) {
+        if (board.is_side(vtx)) {
             for (int idx = 0; idx < intersections; ++idx) {
                 const auto sym_idx = Board::symmetry_nn_idx_table[symmetry][idx];
                 if (legalmove_idx == sym_idx) {
@@ -276,7 +296,7 @@ void fill_special_moves_planes(const std::shared_ptr<Board> board,
                     break;
                 }
             }
-        } else if (board->is_corner(vtx)) {
+        } else if (board.is_corner(vtx)) {
             for (int idx = 0; idx < intersections; ++idx) {
                 const auto sym_idx = Board::symmetry_nn_idx_table[symmetry][idx];
                 if (legalmove_idx == sym_idx) {
@@ -297,15 +317,27 @@ void fill_special_moves_planes(const std::shared_ptr<Board> board,
 }
 
 
-std::vector<float> Model::gather_planes(const GameState *const state, 
+std::vector<float> Model::gather_planes(const Position *const state, 
                                         const int symmetry) {
+
+    const int intersections = state->board.get_intersections();
+    auto input_data = std::vector<float>(INPUT_CHANNELS * intersections);
+    gather_planes(state, symmetry, std::begin(input_data));
+
+    return input_data;
+}
+
+void Model::gather_planes(const Position *const state,
+                          const int symmetry,
+                          std::vector<float>::iterator planes) {
     static constexpr auto PAST_MOVES = 5;
     static constexpr auto INPUT_PAIRS = 7;
     
 
 
     const int intersections = state->board.get_intersections();
-    auto input_data = std::vector<float>(INPUT_CHANNELS * intersections, 0.0f);
+    const auto planes_end = planes + INPUT_CHANNELS * intersections;
+    std::fill(planes, planes_end, 0.0f);
 
    /*
     * 
@@ -343,7 +375,7 @@ std::vector<float> Model::gather_planes(const GameState *const state,
     const auto to_move = state->board.get_to_move();
     const auto blacks_move = to_move == Board::BLACK;
 
-    auto iterate = std::begin(input_data);
+    auto iterate = planes;
     auto black_it = blacks_move ? iterate
                                 : iterate + INPUT_PAIRS * intersections;
     auto white_it = blacks_move ? iterate + INPUT_PAIRS * intersections
@@ -353,7 +385,8 @@ std::vector<float> Model::gather_planes(const GameState *const state,
         std::min<size_t>(state->board.get_movenum() + 1, PAST_MOVES);
     // plane 1 to 5 and plane 8 to 12
     for (auto h = size_t{0}; h < moves; ++h) {
-        fill_color_plane_pair(state->get_past_board(h),
+        fill_color_plane_pair(state->board,
+                              state->get_past_board(h),
                               black_it + h * intersections,
                               white_it + h * intersections,
                               symmetry);
@@ -362,7 +395,7 @@ std::vector<float> Model::gather_planes(const GameState *const state,
     std::advance(white_it, PAST_MOVES * intersections);
 
     // plane 6 and plane 13
-    fill_side_plane_pair(state->get_past_board(0),
+    fill_side_plane_pair(state->board,
                          black_it,
                          white_it,
                          symmetry);
@@ -370,7 +403,7 @@ std::vector<float> Model::gather_planes(const GameState *const state,
     std::advance(white_it,  intersections);
 
     // plane 7 and plane 14
-    fill_corner_plane_pair(state->get_past_board(0),
+    fill_corner_plane_pair(state->board,
                            black_it,
                            white_it,
                            symmetry);
@@ -380,14 +413,15 @@ std::vector<float> Model::gather_planes(const GameState *const state,
 
     // plane 15 and plane 19
     for (auto h = size_t{0}; h < moves; ++h) {
-        fill_move_plane(state->get_past_board(h),
+        fill_move_plane(state->board,
+                        state->get_past_board(h),
                         iterate + h * intersections,
                         symmetry);
     }
     std::advance(iterate, PAST_MOVES * intersections);
 
     // plane 20 and plane 22
-    fill_special_moves_planes(state->get_past_board(0),
+    fill_special_moves_planes(state->board,
                               iterate,
                               symmetry);
     std::advance(iterate, 3 * intersections);
@@ -402,32 +436,36 @@ std::vector<float> Model::gather_planes(const GameState *const state,
     std::fill(iterate, iterate+intersections, static_cast<float>(true));
     std::advance(iterate,  intersections);
 
-    assert(iterate == std::end(input_data));
+    assert(iterate == planes_end);
+}
+
+std::vector<float> Model::gather_features(const Position *const state) {
+
+    auto input_data = std::vector<float>(INPUT_FEATURES);
+    gather_features(state, std::begin(input_data));
 
     return input_data;
 }
 
-std::vector<float> Model::gather_features(const GameState *const state) {
+void Model::gather_features(const Position *const state,
+                            std::vector<float>::iterator features) {
 
     static constexpr auto FEATURE_PASS = 10;
 
-    auto input_data = std::vector<float>(INPUT_FEATURES, 0.0f);
+    std::fill(features, features + INPUT_FEATURES, 0.0f);
   
     auto roll = size_t{0};
     const auto moves =
         std::min<size_t>(state->board.get_movenum() + 1, FEATURE_PASS);
 
     for (auto i = size_t{0}; i < moves; ++i) {
-        const auto board = state->get_past_board(i);
-        const auto move = board->get_last_move();
+        const auto move = state->get_past_board(i).lastmove;
         if (move == Board::PASS) { 
-            input_data[roll + i] = 1.0f;
+            features[roll + i] = 1.0f;
         }
     }
     roll += FEATURE_PASS;
-    assert(roll == input_data.size());
-
-    return input_data;
+    assert(roll == INPUT_FEATURES);
 }
 
 void Model::features_stream(std::ostream &out, const GameState *const state, const int symmetry) {
@@ -466,25 +504,34 @@ std::string Model::features_to_string(GameState &state, const int symmetry) {
     return out.str();
 }
 
-NNResult Model::get_result(const GameState *const state,
-                           std::vector<float> &policy,
-                           std::vector<float> &score_belief,
-                           std::vector<float> &ownership,
-                           std::vector<float> &final_score,
-                           std::vector<float> &values,
+NNResult Model::get_result(const Position *const state,
+                           const float *policy,
+                           const float *score_belief,
+                           const float *ownership,
+                           const float *final_score,
+                           const float *values,
                            const float softmax_temp,
                            const int symmetry) {
     NNResult result;
 
     const auto intersections = state->get_intersections();
 
-    // Probabilities
-    const auto probabilities = Activation::Softmax(policy, softmax_temp);
+    // Probabilities, the softmax is written to the result directly.
+    const auto alpha = *std::max_element(policy, policy + intersections + 1);
+    auto denom = 0.0f;
     for (int idx = 0; idx < intersections; ++idx) {
         const auto sym_idx = Board::symmetry_nn_idx_table[symmetry][idx];
-        result.policy[sym_idx] = probabilities[idx];
+        const auto val = std::exp((policy[idx] - alpha) / softmax_temp);
+        result.policy[sym_idx] = val;
+        denom += val;
     }
-    result.policy_pass = probabilities[intersections];
+    result.policy_pass = std::exp((policy[intersections] - alpha) / softmax_temp);
+    denom += result.policy_pass;
+
+    for (int idx = 0; idx < intersections; ++idx) {
+        result.policy[idx] /= denom;
+    }
+    result.policy_pass /= denom;
 
     // Score belief
     (void) score_belief;
@@ -506,14 +553,14 @@ NNResult Model::get_result(const GameState *const state,
     return result;
 }
 
-float Model::get_winrate(GameState &state, const NNResult &result) {
+float Model::get_winrate(Position &state, const NNResult &result) {
     const auto komi = state.get_komi();
     const auto color = state.get_to_move();
     const auto current_komi = (color == Board::BLACK ? komi : -komi);
     return get_winrate(state, result, current_komi);
 }
 
-float Model::get_winrate(GameState &state, const NNResult &result, float current_komi) {
+float Model::get_winrate(Position &state, const NNResult &result, float current_komi) {
     const auto intersections = state.get_intersections();
     const auto alpha = result.alpha;
     const auto beta = std::exp(result.beta) * 10.f / intersections;
@@ -522,9 +569,64 @@ float Model::get_winrate(GameState &state, const NNResult &result, float current
     return (winrate + 1.0f) / 2.0f;
 }
 
+void Model::NNpipe::forward_batch(const int boardsize,
+                                  const int batch_size,
+                                  const std::vector<float> &planes,
+                                  const std::vector<float> &features,
+                                  std::vector<float> &output_pol,
+                                  std::vector<float> &output_sb,
+                                  std::vector<float> &output_os,
+                                  std::vector<float> &output_fs,
+                                  std::vector<float> &output_val) {
+
+    const auto slice = [](const std::vector<float> &batch,
+                          const int b, const int size) {
+        const auto begin = std::begin(batch) + b * size;
+        return std::vector<float>(begin, begin + size);
+    };
+
+    const auto intersections = boardsize * boardsize;
+    const auto planes_size = INPUT_CHANNELS * intersections;
+    const auto pol_size = POTENTIAL_MOVES;
+    const auto sb_size = OUTPUTS_SCOREBELIEF * intersections;
+    const auto os_size = OUTPUTS_OWNERSHIP * intersections;
+
+    auto pol = std::vector<float>(pol_size);
+    auto sb = std::vector<float>(sb_size);
+    auto os = std::vector<float>(os_size);
+    auto fs = std::vector<float>(FINAL_SCORE);
+    auto val = std::vector<float>(VALUE_MISC);
+
+    for (int b = 0; b < batch_size; ++b) {
+        forward(boardsize,
+                slice(planes, b, planes_size),
+                slice(features, b, INPUT_FEATURES),
+                pol, sb, os, fs, val);
+
+        std::copy(std::begin(pol), std::end(pol), std::begin(output_pol) + b * pol_size);
+        std::copy(std::begin(sb), std::end(sb), std::begin(output_sb) + b * sb_size);
+        std::copy(std::begin(os), std::end(os), std::begin(output_os) + b * os_size);
+        std::copy(std::begin(fs), std::end(fs), std::begin(output_fs) + b * FINAL_SCORE);
+        std::copy(std::begin(val), std::end(val), std::begin(output_val) + b * VALUE_MISC);
+    }
+}
+
 void Model::winograd_transform(std::shared_ptr<NNweights> &nn_weight) {
 
+    if (!nn_weight->loaded) {
+        return;
+    }
+
     auto channels = nn_weight->channels;
+
+    fold_batchnorm(nn_weight->input_conv, nn_weight->input_bn);
+    fold_batchnorm(nn_weight->p_conv, nn_weight->p_bn);
+    fold_batchnorm(nn_weight->v_conv, nn_weight->v_bn);
+    for (auto &tower_ref : nn_weight->residual_tower) {
+        fold_batchnorm(tower_ref.conv_1, tower_ref.bn_1);
+        fold_batchnorm(tower_ref.conv_2, tower_ref.bn_2);
+    }
+
     nn_weight->input_conv.weights = winograd_transform_f(
         nn_weight->input_conv.weights, channels, INPUT_CHANNELS);
 
@@ -34,6 +34,9 @@ struct Desc {
     struct ConvLayer {
         void load_weights(std::vector<float> &loadweights);
         std::vector<float> weights;
+
+        // Only the layers folded with the batch normalization have the biases.
+        std::vector<float> biases;
     };
 
     struct BatchNormLayer {
@@ -99,6 +102,10 @@ struct Model {
 
     class NNpipe {
     public:
+        // The backends own their weights and workspaces, and they are
+        // destroyed through this class.
+        virtual ~NNpipe() = default;
+
         virtual void initialize(std::shared_ptr<NNweights> weights) = 0;
         virtual void forward(const int boardsize,
                              const std::vector<float> &planes,
@@ -109,6 +116,18 @@ struct Model {
                              std::vector<float> &output_fs,
                              std::vector<float> &output_val) = 0;
 
+        // Forward the positions at once. The inputs and the outputs of the
+        // positions are one after another. The default runs them one by one.
+        virtual void forward_batch(const int boardsize,
+                                   const int batch_size,
+                                   const std::vector<float> &planes,
+                                   const std::vector<float> &features,
+                                   std::vector<float> &output_pol,
+                                   std::vector<float> &output_sb,
+                                   std::vector<float> &output_os,
+                                   std::vector<float> &output_fs,
+                                   std::vector<float> &output_val);
+
         virtual void reload(std::shared_ptr<Model::NNweights> weights) = 0;
         virtual void release() = 0;
         virtual void destroy() = 0;
@@ -120,10 +139,18 @@ struct Model {
     static void fill_weights(std::istream &weights_file,
                              std::shared_ptr<NNweights> &nn_weight);
 
-    static std::vector<float> gather_planes(const GameState *const state, 
+    static std::vector<float> gather_planes(const Position *const state, 
                                             const int symmetry);
 
-    static std::vector<float> gather_features(const GameState *const state);
+    static std::vector<float> gather_features(const Position *const state);
+
+    // Write the inputs to the buffer instead of allocating them.
+    static void gather_planes(const Position *const state,
+                              const int symmetry,
+                              std::vector<float>::iterator planes);
+
+    static void gather_features(const Position *const state,
+                                std::vector<float>::iterator features);
 
     static void features_stream(std::ostream &out,
                                 const GameState *const state,
@@ -131,18 +158,21 @@ struct Model {
 
     static std::string features_to_string(GameState &state, const int symmetry);
 
-    static NNResult get_result(const GameState *const state,
-                               std::vector<float> &policy,
-                               std::vector<float> &score_belief,
-                               std::vector<float> &ownership,
-                               std::vector<float> &final_score,
-                               std::vector<float> &values,
+    // The outputs of one position, which may be a part of the batch.
+    static NNResult get_result(const Position *const state,
+                               const float *policy,
+                               const float *score_belief,
+                               const float *ownership,
+                               const float *final_score,
+                               const float *values,
                                const float softmax_temp,
                                const int symmetry);
 
-    static float get_winrate(GameState &state, const NNResult &result);
-    static float get_winrate(GameState &state, const NNResult &result, float current_komi);
+    static float get_winrate(Position &state, const NNResult &result);
+    static float get_winrate(Position &state, const NNResult &result, float current_komi);
 
+    // Fold the batch normalizations into the convolutions, and transform
+    // the 3x3 convolutions for the Winograd.
     static void winograd_transform(std::shared_ptr<NNweights> &nn_weight);
 
     static void fill_fullyconnect_layer(Desc::LinearLayer &layer, std::istream &weights_file);
@@ -39,10 +39,11 @@
 using namespace Utils;
 
 Network::~Network() {
+    m_scheduler.quit();
     m_forward->destroy();  
 }
 
-void Network::initialize(const int playouts, const std::string &weightsfile) {
+void Network::initialize(const std::string &weightsfile) {
 
 #ifndef __APPLE__
 #ifdef USE_OPENBLAS
@@ -62,7 +63,7 @@ void Network::initialize(const int playouts, const std::string &weightsfile) {
     auto_printf("BLAS Core: built-in Eigen %d.%d.%d library.\n",
                 EIGEN_WORLD_VERSION, EIGEN_MAJOR_VERSION, EIGEN_MINOR_VERSION);
 #endif
-    set_playouts(playouts);
+    set_cache_memory(option<int>("cache_memory_mb"));
 
 #ifdef USE_CUDA
     using backend = CUDAbackend;
@@ -83,6 +84,26 @@ void Network::initialize(const int playouts, const std::string &weightsfile) {
 
     m_weights.reset();
     m_weights = nullptr;
+
+    // The buffers of the largest batch are ready before the search.
+    const auto batch_size = option<int>("batchsize");
+    {
+        auto workspace = m_workspaces.acquire();
+        workspace->reserve(std::max(batch_size, option<int>("leaf_batch")));
+        m_workspaces.release(std::move(workspace));
+    }
+
+    // The requests of all search threads are batched by the scheduler.
+    if (batch_size > 1) {
+        const auto threads = option<int>("evaluator_threads");
+        m_scheduler.initialize(
+            [this](const std::vector<BatchScheduler::Request *> &batch) {
+                get_output_internal(batch.data(), batch.size());
+            },
+            threads, batch_size, 1000 * option<int>("waittime"));
+        auto_printf("Batch scheduler : %d evaluator threads, batch size %d\n",
+                    threads, batch_size);
+    }
 }
 
 void Network::reload_weights(const std::string &weightsfile) {
@@ -101,101 +122,195 @@ void Network::reload_weights(const std::string &weightsfile) {
     m_weights = nullptr;
 }
 
-void Network::set_playouts(const int playouts) {
-    const size_t cache_size = option<int>("cache_moves") * playouts;
-    m_cache.resize(cache_size);
+void Network::set_cache_memory(const int megabytes) {
+    m_cache.set_memory(megabytes);
 }
 
-// TODO: probe_cache 翻轉搜尋?
-bool Network::probe_cache(const GameState *const state,
-                          Network::Netresult &result,
-                          const int symmetry) {
+void Network::dump_batch_stats() {
+    m_scheduler.dump_stats();
+}
+
+void Network::canonical_transform(const Board &board,
+                                  Network::Netresult &result,
+                                  const bool to_canonical) {
 
-    const bool success = m_cache.lookup(state->board.get_hash(), result);
+    const auto symmetry = board.get_canonical_symmetry();
+    if (symmetry == IDENTITY_SYMMETRY) {
+        return;
+    }
 
-  // If we are not generating a self-play game, try to find
-  // symmetries if we are in the early opening.
-  /*
-if (!cfg_noise && !cfg_random_cnt
-  && state->get_movenum()
-     < (state->get_timecontrol().opening_moves(BOARD_SIZE) / 2)) {
-  for (auto sym = 0; sym < Network::NUM_SYMMETRIES; ++sym) {
-      if (sym == Network::IDENTITY_SYMMETRY) {
-          continue;
-      }
-      const auto hash = state->get_symmetry_hash(sym);
-      if (m_cache.lookup(hash, result)) {
-          decltype(result.policy) corrected_policy;
-          for (auto idx = size_t{0}; idx < NUM_INTERSECTIONS; ++idx) {
-              const auto sym_idx = symmetry_nn_idx_table[sym][idx];
-              corrected_policy[idx] = result.policy[sym_idx];
-          }
-          result.policy = std::move(corrected_policy);
-          return true;
-      }
-  }
+    const auto intersections = board.get_intersections();
+    auto policy = result.policy;
+    auto ownership = result.ownership;
+
+    for (int idx = 0; idx < intersections; ++idx) {
+        const auto sym_idx = board.get_transform_idx(idx, symmetry);
+        if (to_canonical) {
+            policy[sym_idx] = result.policy[idx];
+            ownership[sym_idx] = result.ownership[idx];
+        } else {
+            policy[idx] = result.policy[sym_idx];
+            ownership[idx] = result.ownership[sym_idx];
+        }
+    }
+    result.policy = policy;
+    result.ownership = ownership;
 }
-  */
 
-    return success;
+bool Network::probe_cache(const Position *const state,
+                          Network::Netresult &result) {
+
+    const auto hash = state->board.get_canonical_hash();
+    auto entry = CompressedNNResult{};
+    if (!m_cache.lookup(hash, entry)) {
+        return false;
+    }
+    entry.decompress(result);
+    canonical_transform(state->board, result, false);
+    return true;
 }
 
-void Network::dummy_forward(std::vector<float> &policy,
-                            std::vector<float> &ownership,
-                            std::vector<float> &final_score,
-                            std::vector<float> &values) {
+void Network::insert_cache(const Position *const state,
+                           const Network::Netresult &result) {
+
+    const auto &board = state->board;
+    const auto hash = board.get_canonical_hash();
+    const auto symmetry = board.get_canonical_symmetry();
+    auto canonical_result = result;
+    canonical_transform(board, canonical_result, true);
+
+    // Only the policy of the legal moves is kept.
+    auto legal_mask = std::uint64_t{0};
+    for (const auto vtx : board.get_movelist(board.get_to_move())) {
+        if (vtx != Board::PASS) {
+            const auto idx = board.get_index(board.get_x(vtx), board.get_y(vtx));
+            legal_mask |= std::uint64_t{1} << board.get_transform_idx(idx, symmetry);
+        }
+    }
+
+    auto entry = CompressedNNResult{};
+    if (entry.compress(canonical_result, legal_mask)) {
+        m_cache.insert(hash, entry);
+    }
+}
+
+void Network::dummy_forward(float *policy,
+                            float *ownership,
+                            float *final_score,
+                            float *values) {
 
     auto rng = Random<random_t::XoroShiro128Plus>::get_Rng();
     auto dis = std::uniform_real_distribution<float>(0.0, 1.0);
-    for (auto & p : policy) {
-        p = dis(rng);
+    for (auto idx = 0; idx < POTENTIAL_MOVES; ++idx) {
+        policy[idx] = dis(rng);
     }
-    const auto acc = std::accumulate(std::begin(policy),
-                                         std::end(policy), 0.0f);
-    for (auto & p : policy) {
-        p /= acc;
+    const auto acc = std::accumulate(policy, policy + POTENTIAL_MOVES, 0.0f);
+    for (auto idx = 0; idx < POTENTIAL_MOVES; ++idx) {
+        policy[idx] /= acc;
     }
 
     values[0] = 0.0f;
     values[1] = 1.0f;
     // values[2] = 0.0f;
 
-    for (auto &owner : ownership) {
-        owner = 0.0f;
-    }
+    std::fill(ownership, ownership + OUTPUTS_OWNERSHIP * NUM_INTERSECTIONS, 0.0f);
 
     final_score[0] = 0.0f;
 }
 
+void Network::Workspace::reserve(const size_t batch_size) {
+    const auto grow = [](std::vector<float> &buffer, const size_t size) {
+        if (buffer.size() < size) {
+            buffer.resize(size);
+        }
+    };
+
+    grow(planes, batch_size * INPUT_CHANNELS * NUM_INTERSECTIONS);
+    grow(features, batch_size * INPUT_FEATURES);
+    grow(policy, batch_size * POTENTIAL_MOVES);
+    grow(scorebelief, batch_size * OUTPUTS_SCOREBELIEF * NUM_INTERSECTIONS);
+    grow(ownership, batch_size * OUTPUTS_OWNERSHIP * NUM_INTERSECTIONS);
+    grow(finalscore, batch_size * FINAL_SCORE);
+    grow(winrate, batch_size * VALUE_MISC);
+}
+
 Network::Netresult Network::get_output_internal(const GameState *const state,
                                                 const int symmetry) {
     assert(symmetry >= 0 && symmetry < NUM_SYMMETRIES);
 
-    auto policy_out = std::vector<float>(POTENTIAL_MOVES);
-    auto scorebelief_out = std::vector<float>(OUTPUTS_SCOREBELIEF * NUM_INTERSECTIONS);
-    auto finalscore_out = std::vector<float>(FINAL_SCORE);
-    auto ownership_out = std::vector<float>(OUTPUTS_OWNERSHIP * NUM_INTERSECTIONS);
-    auto winrate_out = std::vector<float>(VALUE_MISC);
-
-    const auto boardsize = state->board.get_boardsize();
-    const auto input_planes = Model::gather_planes(state, symmetry);
-    const auto input_features = Model::gather_features(state);
-    if (m_forward->valid()) {
-        m_forward->forward(boardsize, input_planes, input_features,
-                           policy_out, scorebelief_out, ownership_out, finalscore_out, winrate_out);
-    } else {
-        dummy_forward(policy_out, ownership_out, finalscore_out, winrate_out);
+    BatchScheduler::Request request;
+    request.state = state;
+    request.symmetry = symmetry;
+
+    auto request_ptr = &request;
+    forward(&request_ptr, 1);
+
+    return request.result;
+}
+
+void Network::get_output_internal(BatchScheduler::Request *const *requests,
+                                  const size_t batch_size) {
+
+    auto workspace = m_workspaces.acquire();
+    workspace->reserve(batch_size);
+
+    // The outputs of each position are as large as the board.
+    const auto boardsize = requests[0]->state->board.get_boardsize();
+    const auto intersections = boardsize * boardsize;
+    const auto planes_size = INPUT_CHANNELS * intersections;
+    const auto sb_size = OUTPUTS_SCOREBELIEF * intersections;
+    const auto os_size = OUTPUTS_OWNERSHIP * intersections;
+
+    for (auto b = size_t{0}; b < batch_size; ++b) {
+        const auto state = requests[b]->state;
+        assert(state->board.get_boardsize() == boardsize);
+        Model::gather_planes(state, requests[b]->symmetry,
+                             std::begin(workspace->planes) + b * planes_size);
+        Model::gather_features(state,
+                               std::begin(workspace->features) + b * INPUT_FEATURES);
     }
 
-    const auto result = Model::get_result(state,
-                                          policy_out,
-                                          scorebelief_out,
-                                          ownership_out,
-                                          finalscore_out,
-                                          winrate_out,
-                                          option<float>("softmax_temp"), symmetry);
+    const auto valid = m_forward->valid();
+    if (valid) {
+        m_forward->forward_batch(boardsize, batch_size,
+                                 workspace->planes, workspace->features,
+                                 workspace->policy, workspace->scorebelief,
+                                 workspace->ownership, workspace->finalscore,
+                                 workspace->winrate);
+    }
 
-    return result;
+    for (auto b = size_t{0}; b < batch_size; ++b) {
+        const auto policy = workspace->policy.data() + b * POTENTIAL_MOVES;
+        const auto scorebelief = workspace->scorebelief.data() + b * sb_size;
+        const auto ownership = workspace->ownership.data() + b * os_size;
+        const auto finalscore = workspace->finalscore.data() + b * FINAL_SCORE;
+        const auto winrate = workspace->winrate.data() + b * VALUE_MISC;
+
+        if (!valid) {
+            dummy_forward(policy, ownership, finalscore, winrate);
+        }
+
+        requests[b]->result = Model::get_result(requests[b]->state,
+                                                policy,
+                                                scorebelief,
+                                                ownership,
+                                                finalscore,
+                                                winrate,
+                                                option<float>("softmax_temp"),
+                                                requests[b]->symmetry);
+    }
+
+    m_workspaces.release(std::move(workspace));
+}
+
+void Network::forward(BatchScheduler::Request *const *requests,
+                      const size_t batch_size) {
+
+    if (m_scheduler.running()) {
+        m_scheduler.evaluate(requests, batch_size);
+    } else {
+        get_output_internal(requests, batch_size);
+    }
 }
 
 Network::Netresult
@@ -208,7 +323,7 @@ Network::get_output(const GameState *const state,
     Netresult result;
 
     if (read_cache) {
-        if (probe_cache(state, result, symmetry)) {
+        if (probe_cache(state, result)) {
             return result;
         }
     }
@@ -227,11 +342,53 @@ Network::get_output(const GameState *const state,
     }
 
     if (write_cache) {
-        m_cache.insert(state->board.get_hash(), result);
+        insert_cache(state, result);
     }
     return result;
 }
 
+void Network::get_output_batch(const std::vector<const Position *> &states,
+                               std::vector<Netresult> &results,
+                               BatchBuffer &buffer,
+                               const bool read_cache,
+                               const bool write_cache) {
+
+    results.resize(states.size());
+    auto rng = Random<random_t::XoroShiro128Plus>::get_Rng();
+
+    // The requests can't be moved, so they are made again only if there
+    // are not enough.
+    auto &requests = buffer.requests;
+    auto &missed = buffer.missed;
+    if (requests.size() < states.size()) {
+        requests = std::vector<BatchScheduler::Request>(states.size());
+    }
+    missed.clear();
+
+    // Only the positions missing in the cache are forwarded.
+    for (auto i = size_t{0}; i < states.size(); ++i) {
+        if (read_cache && probe_cache(states[i], results[i])) {
+            continue;
+        }
+        requests[i].state = states[i];
+        requests[i].symmetry = rng.randfix<NUM_SYMMETRIES>();
+        missed.emplace_back(&requests[i]);
+    }
+
+    if (missed.empty()) {
+        return;
+    }
+
+    forward(missed.data(), missed.size());
+    for (auto r : missed) {
+        const auto i = static_cast<size_t>(r - requests.data());
+        results[i] = r->result;
+        if (write_cache) {
+            insert_cache(states[i], results[i]);
+        }
+    }
+}
+
 void Network::release_nn() {
     m_forward->release();
 }
@@ -4,9 +4,11 @@
 #include <cassert>
 
 #include "Model.h"
+#include "BatchScheduler.h"
 #include "Board.h"
 #include "Cache.h"
 #include "GameState.h"
+#include "WorkspacePool.h"
 class Network {
 public:
     ~Network();
@@ -16,7 +18,7 @@ public:
     using Netresult = NNResult;
     using PolicyVertexPair = std::pair<float, int>;
 
-    void initialize(const int playouts, const std::string &weightsfile);
+    void initialize(const std::string &weightsfile);
 
     void reload_weights(const std::string &weightsfile);
 
@@ -26,37 +28,87 @@ public:
                          const bool read_cache = true,
                          const bool write_cache = true);
 
+    // The storage of the batched evaluation. Each search thread keeps its
+    // own, so the batches allocate nothing once it is large enough.
+    struct BatchBuffer {
+        std::vector<BatchScheduler::Request> requests;
+        std::vector<BatchScheduler::Request *> missed;
+    };
+
+    // Evaluate the positions at once, and write their results in the
+    // same order. Each position takes a random symmetry.
+    void get_output_batch(const std::vector<const Position *> &states,
+                          std::vector<Netresult> &results,
+                          BatchBuffer &buffer,
+                          const bool read_cache = true,
+                          const bool write_cache = true);
+
     void clear_cache();
 
     void release_nn();
 
-    void set_playouts(const int playouts);
+    void set_cache_memory(const int megabytes);
 
+    // Print the stats of the batch scheduler since the last dump.
+    void dump_batch_stats();
 
 private:
     static constexpr int NUM_SYMMETRIES = Board::NUM_SYMMETRIES;
     static constexpr int IDENTITY_SYMMETRY = Board::IDENTITY_SYMMETRY;
 
-    bool probe_cache(const GameState *const state,
-                     Network::Netresult &result,
-                     const int symmetry = -1);
+    bool probe_cache(const Position *const state,
+                     Network::Netresult &result);
+
+    void insert_cache(const Position *const state,
+                      const Network::Netresult &result);
+
+    // The cache stores the result of the canonical symmetry. Transform
+    // the result from the position to the canonical one, or back.
+    static void canonical_transform(const Board &board,
+                                    Network::Netresult &result,
+                                    const bool to_canonical);
+
+    void dummy_forward(float *policy,
+                       float *ownership,
+                       float *final_score,
+                       float *values);
 
-    void dummy_forward(std::vector<float> &policy,
-                       std::vector<float> &ownership,
-                       std::vector<float> &final_score,
-                       std::vector<float> &values);
+    // The inputs and the outputs of one batch.
+    struct Workspace {
+        std::vector<float> planes;
+        std::vector<float> features;
+        std::vector<float> policy;
+        std::vector<float> scorebelief;
+        std::vector<float> ownership;
+        std::vector<float> finalscore;
+        std::vector<float> winrate;
 
+        void reserve(const size_t batch_size);
+    };
 
     Netresult get_output_internal(const GameState *const state,
                                   const int symmetry);
+
+    // Forward the requests in one batch, and write the results to them.
+    void get_output_internal(BatchScheduler::Request *const *requests,
+                             const size_t batch_size);
+
+    // Forward the requests through the batch scheduler if it is running.
+    // Otherwise forward them on this thread.
+    void forward(BatchScheduler::Request *const *requests,
+                 const size_t batch_size);
   
     Netresult get_output_form_cache(const GameState *const state);
 
-    Cache<NNResult> m_cache;
+    Cache<CompressedNNResult> m_cache;
 
     std::unique_ptr<Model::NNpipe> m_forward;
     std::shared_ptr<Model::NNweights> m_weights;
 
+    WorkspacePool<Workspace> m_workspaces;
+
+    BatchScheduler m_scheduler;
+
 };
 
 
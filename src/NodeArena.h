@@ -0,0 +1,160 @@
+#ifndef NODEARENA_H_INCLUDE
+#define NODEARENA_H_INCLUDE
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * The memory of one search tree. Every thread bumps through its own
+ * chunk, so allocating needs no lock. The objects are never destroyed
+ * one by one, release() frees all chunks at once. So they must be
+ * trivially destructible.
+ */
+class NodeArena {
+public:
+    static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+    NodeArena() : m_id(get_next_id()) {}
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    template<typename T, typename... Args>
+    T *create(Args&&... args);
+
+    // Allocate the memory for count objects. They are not constructed.
+    template<typename T>
+    T *allocate_array(const size_t count);
+
+    // Free all objects. No thread may use them after it.
+    void release();
+
+    size_t get_memory_used() const;
+
+private:
+    struct LocalChunk {
+        std::uint64_t arena_id{0};
+        char *current{nullptr};
+        char *end{nullptr};
+    };
+
+    void *allocate(const size_t size, const size_t align);
+
+    static LocalChunk &get_local_chunk();
+
+    static std::uint64_t get_next_id();
+
+    // It changes after each release, so the chunks of the threads are
+    // not used any more.
+    std::atomic<std::uint64_t> m_id;
+
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    std::atomic<size_t> m_memory_used{0};
+};
+
+/*
+ * The fixed size array allocated from the arena.
+ */
+template<typename T>
+class ArenaArray {
+public:
+    ArenaArray() = default;
+    ArenaArray(T *data, const size_t size) : m_data(data), m_size(size) {}
+
+    T *begin() const { return m_data; }
+    T *end() const { return m_data + m_size; }
+    T &operator[](const size_t idx) const { return m_data[idx]; }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    T *m_data{nullptr};
+    size_t m_size{0};
+};
+
+template<typename T, typename... Args>
+T *NodeArena::create(Args&&... args) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "The destructor of the arena object is never called!\n");
+    auto ptr = allocate(sizeof(T), alignof(T));
+    return new (ptr) T(std::forward<Args>(args)...);
+}
+
+template<typename T>
+T *NodeArena::allocate_array(const size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "The destructor of the arena object is never called!\n");
+    return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+}
+
+inline void *NodeArena::allocate(const size_t size, const size_t align) {
+    auto &chunk = get_local_chunk();
+    const auto id = m_id.load(std::memory_order_relaxed);
+
+    if (chunk.arena_id == id) {
+        const auto addr = reinterpret_cast<std::uintptr_t>(chunk.current);
+        const auto aligned = (addr + align - 1) & ~(std::uintptr_t{align} - 1);
+        auto ptr = reinterpret_cast<char *>(aligned);
+        if (ptr + size <= chunk.end) {
+            chunk.current = ptr + size;
+            return ptr;
+        }
+    }
+
+    // Get a new chunk for this thread. The large allocation takes its own.
+    const auto chunk_size = std::max(size_t{CHUNK_SIZE}, size + align);
+    auto buffer = std::unique_ptr<char[]>(new char[chunk_size]);
+    auto begin = buffer.get();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_chunks.emplace_back(std::move(buffer));
+    }
+    m_memory_used.fetch_add(chunk_size, std::memory_order_relaxed);
+
+    const auto addr = reinterpret_cast<std::uintptr_t>(begin);
+    const auto aligned = (addr + align - 1) & ~(std::uintptr_t{align} - 1);
+    auto ptr = reinterpret_cast<char *>(aligned);
+
+    chunk.arena_id = id;
+    chunk.current = ptr + size;
+    chunk.end = begin + chunk_size;
+
+    return ptr;
+}
+
+inline void NodeArena::release() {
+    auto chunks = std::vector<std::unique_ptr<char[]>>{};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::swap(chunks, m_chunks);
+        m_id.store(get_next_id());
+    }
+    m_memory_used.store(0);
+}
+
+inline size_t NodeArena::get_memory_used() const {
+    return m_memory_used.load(std::memory_order_relaxed);
+}
+
+inline NodeArena::LocalChunk &NodeArena::get_local_chunk() {
+    static thread_local LocalChunk chunk;
+    return chunk;
+}
+
+inline std::uint64_t NodeArena::get_next_id() {
+    static std::atomic<std::uint64_t> next_id{1};
+    return next_id.fetch_add(1);
+}
+
+#endif
@@ -1,132 +1,256 @@
+#include <algorithm>
 #include <memory>
 #include <atomic>
 #include <vector>
 #include <cstdint>
 
+#include "NodeArena.h"
+#include "Utils.h"
+
 #define POINTER_MASK (3ULL)
 
 static constexpr std::uint64_t UNINFLATED = 2ULL;
 static constexpr std::uint64_t INFLATING = 1ULL;
 static constexpr std::uint64_t POINTER = 0ULL;
 
-template<typename Node, typename Data>
-class NodePointer {
+/*
+ * The children of one node. They are the packed arrays in one block of
+ * the arena, the tagged node pointers, the visits of the edges, the
+ * policies in half precision and the vertices. So selecting a child is a
+ * linear scan. The node is created at the first time it is inflated.
+ */
+template<typename Node>
+class NodeList {
 public:
-    NodePointer() = default;
-    NodePointer(std::shared_ptr<Data> data);
-    NodePointer(const NodePointer &) = delete;
-    NodePointer& operator=(const NodePointer&);
+    NodeList() = default;
+    NodeList(const NodeList &) = delete;
+    NodeList& operator=(const NodeList&) = delete;
+
+    // Allocate the arrays from the arena of the tree. All children are
+    // uninflated. The visits of the edges are counted only if the nodes
+    // may be shared.
+    template<typename Tree>
+    void initialize(Tree *tree, const size_t size, const bool edge_visits = false);
+
+    void set(const size_t idx, const int vertex, const float policy);
+    void set_policy(const size_t idx, const float policy);
 
+    int get_vertex(const size_t idx) const;
+    float get_policy(const size_t idx) const;
 
-    ~NodePointer();
+    size_t size() const;
+    bool empty() const;
 
-    bool is_pointer() const;
-    bool is_inflating() const;
-    bool is_uninflated() const;
+    bool has_edge_visits() const;
+    int get_edge_visits(const size_t idx) const;
+    void increment_edge_visits(const size_t idx);
 
-    Node *read_ptr(uint64_t v) const;
-    Node *get() const;
+    // Return nullptr if the node is not created yet.
+    Node *get(const size_t idx) const;
 
-    void inflate();
+    // Create the node in the arena of the tree if it is not created. The
+    // node is constructed from the tree, the vertex, the policy and args.
+    template<typename Tree, typename... Args>
+    Node *inflate(const size_t idx, Tree *tree, Args&&... args);
 
-    std::shared_ptr<Data> data() const;
+    // Link the node returned by create() if it is not created. Only one
+    // thread calls create().
+    template<typename Create>
+    Node *inflate_by(const size_t idx, Create create);
+
+    // Copy the list into the arena of the tree. The inflated nodes are
+    // replaced by copy_node(idx, node).
+    template<typename Tree, typename Copy>
+    void copy(Tree *tree, const NodeList &other, Copy copy_node);
 
 private:
+    bool acquire_inflating(const size_t idx);
 
-    bool acquire_inflating();
+    static bool is_pointer(std::uint64_t v);
+    static bool is_inflating(std::uint64_t v);
+    static bool is_uninflated(std::uint64_t v);
+    static Node *read_ptr(std::uint64_t v);
 
-    std::shared_ptr<Data> m_data{nullptr};
-    std::atomic<std::uint64_t> m_pointer{UNINFLATED};
+    // The other arrays follow the pointers in the block. Only one pointer
+    // is kept, so the list is small in the node.
+    std::atomic<std::uint32_t> *edge_visits() const;
+    std::uint16_t *policies() const;
+    std::uint8_t *vertices() const;
 
-    bool is_pointer(std::uint64_t v) const;
-    bool is_inflating(std::uint64_t v) const;
-    bool is_uninflated(std::uint64_t v) const;
+    std::atomic<std::uint64_t> *m_pointers{nullptr};
+    std::uint32_t m_size{0};
+    bool m_has_edge_visits{false};
 };
 
-template<typename Node, typename Data>
-NodePointer<Node, Data>::NodePointer(std::shared_ptr<Data> data) {
-    m_data = data;
+template<typename Node>
+template<typename Tree>
+void NodeList<Node>::initialize(Tree *tree, const size_t size, const bool edge_visits) {
+    const auto bytes = size * (sizeof(std::uint64_t) +
+                                   (edge_visits ? sizeof(std::uint32_t) : 0) +
+                                   sizeof(std::uint16_t) + sizeof(std::uint8_t));
+    const auto words = (bytes + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    m_pointers = reinterpret_cast<std::atomic<std::uint64_t> *>(
+                     tree->arena.template allocate_array<std::uint64_t>(words));
+    m_size = size;
+    m_has_edge_visits = edge_visits;
+
+    for (auto idx = size_t{0}; idx < size; ++idx) {
+        new (&m_pointers[idx]) std::atomic<std::uint64_t>(UNINFLATED);
+    }
+
+    if (edge_visits) {
+        for (auto idx = size_t{0}; idx < size; ++idx) {
+            new (&this->edge_visits()[idx]) std::atomic<std::uint32_t>(0);
+        }
+    }
 }
 
-template<typename Node, typename Data>
-inline bool NodePointer<Node, Data>::is_pointer(std::uint64_t v) const {
-    return (v & POINTER_MASK) == POINTER;
+template<typename Node>
+inline std::atomic<std::uint32_t> *NodeList<Node>::edge_visits() const {
+    return reinterpret_cast<std::atomic<std::uint32_t> *>(m_pointers + m_size);
 }
 
-template<typename Node, typename Data>
-inline bool NodePointer<Node, Data>::is_inflating(std::uint64_t v) const {
-    return (v & POINTER_MASK) == INFLATING;
+template<typename Node>
+inline std::uint16_t *NodeList<Node>::policies() const {
+    auto begin = reinterpret_cast<char *>(m_pointers + m_size);
+    if (m_has_edge_visits) {
+        begin += m_size * sizeof(std::uint32_t);
+    }
+    return reinterpret_cast<std::uint16_t *>(begin);
 }
 
-template<typename Node, typename Data>
-inline bool NodePointer<Node, Data>::is_uninflated(std::uint64_t v) const {
-    return (v & POINTER_MASK) == UNINFLATED;
+template<typename Node>
+inline std::uint8_t *NodeList<Node>::vertices() const {
+    return reinterpret_cast<std::uint8_t *>(policies() + m_size);
+}
+
+template<typename Node>
+inline bool NodeList<Node>::has_edge_visits() const {
+    return m_has_edge_visits;
+}
+
+template<typename Node>
+inline int NodeList<Node>::get_edge_visits(const size_t idx) const {
+    return edge_visits()[idx].load(std::memory_order_relaxed);
+}
+
+template<typename Node>
+inline void NodeList<Node>::increment_edge_visits(const size_t idx) {
+    if (m_has_edge_visits) {
+        edge_visits()[idx].fetch_add(1, std::memory_order_relaxed);
+    }
 }
 
-template<typename Node, typename Data>
-inline bool NodePointer<Node, Data>::is_pointer() const {
-    return is_pointer(m_pointer.load());
+template<typename Node>
+inline void NodeList<Node>::set(const size_t idx, const int vertex, const float policy) {
+    assert(vertex >= 0 && vertex <= 0xff);
+    vertices()[idx] = static_cast<std::uint8_t>(vertex);
+    set_policy(idx, policy);
 }
 
-template<typename Node, typename Data>
-inline bool NodePointer<Node, Data>::is_inflating() const {
-    return is_inflating(m_pointer.load());
+template<typename Node>
+inline void NodeList<Node>::set_policy(const size_t idx, const float policy) {
+    policies()[idx] = Utils::float_to_half(policy);
 }
 
-template<typename Node, typename Data>
-inline bool NodePointer<Node, Data>::is_uninflated() const {
-    return is_uninflated(m_pointer.load());
+template<typename Node>
+inline int NodeList<Node>::get_vertex(const size_t idx) const {
+    return vertices()[idx];
 }
 
-template<typename Node, typename Data>
-inline Node *NodePointer<Node, Data>::read_ptr(uint64_t v) const {
+template<typename Node>
+inline float NodeList<Node>::get_policy(const size_t idx) const {
+    return Utils::half_to_float(policies()[idx]);
+}
+
+template<typename Node>
+inline size_t NodeList<Node>::size() const {
+    return m_size;
+}
+
+template<typename Node>
+inline bool NodeList<Node>::empty() const {
+    return m_size == 0;
+}
+
+template<typename Node>
+inline bool NodeList<Node>::is_pointer(std::uint64_t v) {
+    return (v & POINTER_MASK) == POINTER;
+}
+
+template<typename Node>
+inline bool NodeList<Node>::is_inflating(std::uint64_t v) {
+    return (v & POINTER_MASK) == INFLATING;
+}
+
+template<typename Node>
+inline bool NodeList<Node>::is_uninflated(std::uint64_t v) {
+    return (v & POINTER_MASK) == UNINFLATED;
+}
+
+template<typename Node>
+inline Node *NodeList<Node>::read_ptr(std::uint64_t v) {
     assert(is_pointer(v));
     return reinterpret_cast<Node *>(v & ~(POINTER_MASK));
 }
 
-template<typename Node, typename Data>
-inline Node *NodePointer<Node, Data>::get() const {
-    auto v = m_pointer.load();
+template<typename Node>
+inline Node *NodeList<Node>::get(const size_t idx) const {
+    auto v = m_pointers[idx].load();
     if (is_pointer(v))
         return read_ptr(v);
     return nullptr;
 }
 
-template<typename Node, typename Data>
-bool NodePointer<Node, Data>::acquire_inflating() {
+template<typename Node>
+bool NodeList<Node>::acquire_inflating(const size_t idx) {
     auto uninflated = UNINFLATED;
     auto newval = INFLATING;
-    return m_pointer.compare_exchange_strong(uninflated, newval);
+    return m_pointers[idx].compare_exchange_strong(uninflated, newval);
+}
+
+template<typename Node>
+template<typename Tree, typename... Args>
+Node *NodeList<Node>::inflate(const size_t idx, Tree *tree, Args&&... args) {
+    return inflate_by(idx, [&]() {
+        return tree->arena.template create<Node>(tree, get_vertex(idx), get_policy(idx),
+                                                 std::forward<Args>(args)...);
+    });
 }
 
-template<typename Node, typename Data>
-void NodePointer<Node, Data>::inflate() {
+template<typename Node>
+template<typename Create>
+Node *NodeList<Node>::inflate_by(const size_t idx, Create create) {
     while (true) {
-        auto v = m_pointer.load();
+        auto v = m_pointers[idx].load();
         if (is_pointer(v)) {
-            return;
+            return read_ptr(v);
         }
-        if (!acquire_inflating()) {
+        if (!acquire_inflating(idx)) {
             continue;
         }
-        auto new_ponter =
-            reinterpret_cast<std::uint64_t>(new Node(m_data)) |
-            POINTER;
-        auto old_ponter = m_pointer.exchange(new_ponter);
+        auto node = create();
+        auto new_ponter = reinterpret_cast<std::uint64_t>(node) | POINTER;
+        auto old_ponter = m_pointers[idx].exchange(new_ponter);
         assert(is_inflating(old_ponter));
     }
 }
 
-template<typename Node, typename Data>
-NodePointer<Node, Data>::~NodePointer() {
+template<typename Node>
+template<typename Tree, typename Copy>
+void NodeList<Node>::copy(Tree *tree, const NodeList &other, Copy copy_node) {
+    initialize(tree, other.size(), other.has_edge_visits());
+    std::copy(other.policies(), other.policies() + m_size, policies());
+    std::copy(other.vertices(), other.vertices() + m_size, vertices());
 
-    auto v = m_pointer.load();
-    if (is_pointer(v)) {
-        delete read_ptr(v);
+    for (auto idx = size_t{0}; idx < m_size; ++idx) {
+        if (m_has_edge_visits) {
+            edge_visits()[idx].store(other.get_edge_visits(idx));
+        }
+        if (const auto node = other.get(idx)) {
+            auto new_ponter = reinterpret_cast<std::uint64_t>(copy_node(idx, node)) | POINTER;
+            m_pointers[idx].store(new_ponter);
+        }
     }
 }
-
-template<typename Node, typename Data>
-std::shared_ptr<Data> NodePointer<Node, Data>::data() const {
-    return m_data;
-}
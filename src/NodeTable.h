@@ -0,0 +1,90 @@
+#ifndef NODETABLE_H_INCLUDE
+#define NODETABLE_H_INCLUDE
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+/*
+ * The transposition table of one search tree. It maps the hash of the
+ * position to the node of it, so the different move orders share one
+ * node. It never grows. If the probed entries are full, the node is not
+ * shared.
+ */
+template<typename Node>
+class NodeTable {
+public:
+    static constexpr size_t MAX_PROBES = 8;
+
+    // The size is rounded up to the power of 2.
+    explicit NodeTable(const size_t size);
+
+    NodeTable(const NodeTable&) = delete;
+    NodeTable& operator=(const NodeTable&) = delete;
+
+    // Return nullptr if the position is not in the table.
+    Node *lookup(const std::uint64_t hash) const;
+
+    // Return the node of the position if another thread inserted it first.
+    // Otherwise insert the node and return it.
+    Node *insert(const std::uint64_t hash, Node *node);
+
+private:
+    struct Entry {
+        std::atomic<std::uint64_t> hash{0};
+        std::atomic<Node *> node{nullptr};
+    };
+
+    std::unique_ptr<Entry[]> m_entries;
+    size_t m_mask;
+};
+
+template<typename Node>
+NodeTable<Node>::NodeTable(const size_t size) {
+    auto entries = size_t{1};
+    while (entries < size) {
+        entries <<= 1;
+    }
+    m_entries = std::make_unique<Entry[]>(entries);
+    m_mask = entries - 1;
+}
+
+template<typename Node>
+Node *NodeTable<Node>::lookup(const std::uint64_t hash) const {
+    for (auto p = size_t{0}; p < MAX_PROBES; ++p) {
+        const auto &entry = m_entries[(hash + p) & m_mask];
+        const auto key = entry.hash.load(std::memory_order_acquire);
+        if (key == hash) {
+            // The node may not be stored yet. Take it as not found.
+            return entry.node.load(std::memory_order_acquire);
+        }
+        if (key == 0) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+template<typename Node>
+Node *NodeTable<Node>::insert(const std::uint64_t hash, Node *node) {
+    // Zero marks the empty entry.
+    if (hash == 0) {
+        return node;
+    }
+
+    for (auto p = size_t{0}; p < MAX_PROBES; ++p) {
+        auto &entry = m_entries[(hash + p) & m_mask];
+        auto key = std::uint64_t{0};
+        if (entry.hash.compare_exchange_strong(key, hash)) {
+            entry.node.store(node, std::memory_order_release);
+            return node;
+        }
+        if (key == hash) {
+            const auto shared = entry.node.load(std::memory_order_acquire);
+            return shared ? shared : node;
+        }
+    }
+    return node;
+}
+
+#endif
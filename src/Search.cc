@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <numeric>
 
 #include "Board.h"
@@ -22,7 +23,14 @@ Search::Search(GameState &state, Evaluation &evaluation, Trainer &trainer)
     SearchPool.initialize(threads);
     m_threadGroup = std::make_unique<ThreadGroup<void>>(SearchPool);
     m_parameters = std::make_shared<SearchParameters>();
-    m_endgame_cache.resize(option<int>("playouts"));
+    m_endgame_cache.resize(m_maxplayouts);
+
+    const auto endgame_threads = option<int>("endgame_threads");
+    if (endgame_threads > 0) {
+        m_endgame_pool = std::make_unique<ThreadPool>(endgame_threads);
+        m_endgame_max_pending = ENDGAME_TASKS_PER_THREAD * endgame_threads;
+    }
+    m_reclaim_pool = std::make_unique<ThreadPool>(1);
 }
 
 
@@ -109,40 +117,47 @@ int Search::random_move(bool allow_pass) {
 int Search::uct_search() {
 
     const auto uct_worker = [&](){
+        // Each thread walks its own state. The moves are taken
+        // back after the simulation, so we copy it only once.
+        auto currstate = std::make_unique<GameState>(m_rootstate);
+        auto batch = SearchBatch(m_parameters->leaf_batch);
         do {
-            auto currstate = std::make_unique<GameState>(m_rootstate);
+            if (batch.leaves.size() > 1) {
+                play_simulations(*currstate, m_rootnode, batch);
+                continue;
+            }
             auto result = SearchResult{};
             play_simulation(*currstate, m_rootnode, m_rootnode, result);
             if (result.valid()) {
                 increment_playouts();
             }
-        } while(is_uct_running());
+        } while(is_uct_running() && m_rootnode->get_proven_move() == Board::NO_VERTEX);
     };
 
     // Start to clock.
     m_gamestate.time_clock();
     m_timer.clock();
 
-    const float thinking_time = m_rootstate.get_thinking_time();
+    const float thinking_time = m_gamestate.get_thinking_time();
     auto_printf("Max thinking time : %.4f seconds\n", thinking_time);
 
     if (option<bool>("ponder")) {
-        // If pondering, we clear nodes first.
-        // The nodes are not necessary.
+        // If pondering, we stop it first. The tree is kept
+        // for reusing.
+        set_running(false);
         m_threadGroup->wait_all();
-        clear_nodes();
     }
 
     auto_printf("Initializing...\n");
 
     // Initialize before searching.
-    m_rootstate = m_gamestate;
     int select_move = Board::NO_VERTEX;
     bool keep_running = true;
     bool need_resign = false;
     prepare_uct_search();
-    m_endgame_cache.clear();
+    m_endgame_generation.fetch_add(1);
     updata_root(m_rootnode);
+    const auto reused_visits = m_rootnode->get_visits();
 
     auto_printf("Start searching...\n");
     if (thinking_time > 0.1f) {
@@ -151,16 +166,23 @@ int Search::uct_search() {
         // to wake up the threads
         m_threadGroup->fill_tasks(uct_worker);
     }
+    auto current = std::make_unique<GameState>(m_rootstate);
+    auto batch = SearchBatch(m_parameters->leaf_batch);
     do {
-        auto current = std::make_shared<GameState>(m_rootstate);
-        auto result = SearchResult{};
-        play_simulation(*current, m_rootnode, m_rootnode, result);
-        if (result.valid()) {
-            increment_playouts();
+        if (batch.leaves.size() > 1) {
+            play_simulations(*current, m_rootnode, batch);
+        } else {
+            auto result = SearchResult{};
+            play_simulation(*current, m_rootnode, m_rootnode, result);
+            if (result.valid()) {
+                increment_playouts();
+            }
         }
 
         keep_running &= is_over_playouts();
         keep_running &= is_in_time(thinking_time);
+        // Nothing is left to search if the root is proven by a move.
+        keep_running &= m_rootnode->get_proven_move() == Board::NO_VERTEX;
         set_running(keep_running);
     } while (is_uct_running());
 
@@ -170,8 +192,22 @@ int Search::uct_search() {
     const auto playouts = m_playouts.load();
     auto_printf("Basic :\n");
     auto_printf(" playouts : %d\n", playouts);
+    auto_printf(" reused visits : %d\n", reused_visits);
     auto_printf(" spent : %2.5f (seconds)\n", seconds);
     auto_printf(" speed : %2.5f (playouts/seconds) \n", (float)playouts / seconds );
+    if (m_rootnode->is_proven()) {
+        const auto to_move = m_rootstate.get_to_move();
+        const auto proof = m_rootnode->get_proof(to_move);
+        const auto proof_name = proof == UCTNode::Proof::WIN ? "win" :
+                                    proof == UCTNode::Proof::LOSS ? "loss" : "draw";
+        if (m_rootnode->is_proof_only()) {
+            auto_printf(" proven : %s\n", proof_name);
+        } else {
+            auto_printf(" proven : %s (%.2f)\n", proof_name,
+                        m_rootnode->get_proven_score(to_move));
+        }
+    }
+    m_evaluation.dump_batch_stats();
     UCT_Information::dump_stats(m_rootstate, m_rootnode);
 
     select_move = select_best_move();
@@ -179,7 +215,6 @@ int Search::uct_search() {
     need_resign = Heuristic::should_be_resign(m_rootstate, m_rootnode, option<float>("resigned_threshold"));
  
     m_trainer.gather_step(m_rootstate, *m_rootnode);
-    clear_nodes();
   
     assert(select_move != Board::NO_VERTEX);
 
@@ -190,20 +225,113 @@ int Search::uct_search() {
     }
 
     if (option<bool>("ponder") && select_move != Board::RESIGN) {
-        m_rootstate.play_move(select_move);
-        m_threadGroup->fill_tasks(uct_worker);
+        // The move is replied at once, so the tree is copied by the
+        // next search instead.
+        auto ponder_state = m_rootstate;
+        ponder_state.play_move(select_move);
+        if (reuse_tree(ponder_state, false)) {
+            set_running(true);
+            m_threadGroup->fill_tasks(uct_worker);
+        }
     }
 
     return select_move;
 }
 
+std::vector<std::pair<int, float>> Search::uct_benchmark(const int playouts) {
+    // The same simulations as uct_search, so the leaf batch is used too.
+    const auto simulate = [&](GameState &currstate, SearchBatch &batch) {
+        if (batch.leaves.size() > 1) {
+            play_simulations(currstate, m_rootnode, batch);
+            return;
+        }
+        auto result = SearchResult{};
+        play_simulation(currstate, m_rootnode, m_rootnode, result);
+        if (result.valid()) {
+            increment_playouts();
+        }
+    };
+
+    const auto uct_worker = [&](){
+        auto currstate = std::make_unique<GameState>(m_rootstate);
+        auto batch = SearchBatch(m_parameters->leaf_batch);
+        do {
+            simulate(*currstate, batch);
+        } while(is_uct_running());
+    };
+
+    if (option<bool>("ponder")) {
+        set_running(false);
+        m_threadGroup->wait_all();
+    }
+
+    const auto max_playouts = m_maxplayouts;
+    const auto max_threads = std::max(option<int>("threads"), 1);
+    set_playout(playouts);
+
+    // Free the tree here, so the reclaimer thread never runs with the
+    // timed pass.
+    const auto free_tree = [&]() {
+        m_rootnode = nullptr;
+        m_tree.reset();
+    };
+
+    const auto run = [&](const int threads) {
+        free_tree();
+        prepare_uct_search();
+        m_endgame_cache.clear();
+        updata_root(m_rootnode);
+
+        m_timer.clock();
+        for (auto t = 1; t < threads; ++t) {
+            m_threadGroup->add_task(uct_worker);
+        }
+        auto current = std::make_unique<GameState>(m_rootstate);
+        auto batch = SearchBatch(m_parameters->leaf_batch);
+        do {
+            simulate(*current, batch);
+            set_running(is_over_playouts());
+        } while (is_uct_running());
+
+        m_threadGroup->wait_all();
+
+        const auto seconds = m_timer.get_duration();
+        const auto speed = (float)m_playouts.load() / seconds;
+        free_tree();
+        return speed;
+    };
+
+    // The threads count doubles each time, and the last one is all threads.
+    auto speed_list = std::vector<std::pair<int, float>>{};
+    for (auto threads = 1; ; threads = std::min(2 * threads, max_threads)) {
+        // The first passes fill the NN cache and are dropped. Otherwise the
+        // first threads count pays for all network evaluations, and the
+        // speed of the others is not from the tree. The cached outputs are
+        // compressed, so the second pass still reaches new positions.
+        for (auto pass = 0; pass < BENCHMARK_WARMUP_PASSES; ++pass) {
+            run(threads);
+        }
+        speed_list.emplace_back(threads, run(threads));
+        if (threads == max_threads) {
+            break;
+        }
+    }
+
+    m_maxplayouts = max_playouts;
+    return speed_list;
+}
+
 void Search::prepare_uct_search() {
     auto_printf("preparing uct search...\n");
-    assert(m_rootnode == nullptr);
-    auto root_data = std::make_shared<UCTData>();
-    root_data->parameters = m_parameters;
-
-    m_rootnode = new UCTNode(root_data);
+    if (!m_parameters->reuse_tree || !reuse_tree(m_gamestate)) {
+        clear_nodes();
+        m_tree = create_tree();
+        m_rootnode = m_tree->arena.create<UCTNode>(m_tree.get(), Board::NO_VERTEX, 0.0f, 0);
+        if (m_tree->table) {
+            m_tree->table->insert(m_gamestate.board.get_hash(), m_rootnode);
+        }
+        m_rootstate = m_gamestate;
+    }
     m_playouts.store(0);
 
     set_running(true);
@@ -213,6 +341,12 @@ void Search::updata_root(UCTNode *root_node) {
     auto_printf("updating root...\n");
     std::shared_ptr<NNOutput> nn_output;
     root_node->prepare_root_node(m_evaluation, m_rootstate, nn_output);
+    if (!nn_output) {
+        // The root is reused from the last search.
+        auto_printf("Root :\n");
+        auto_printf(" reused visits = %d\n", root_node->get_visits());
+        return;
+    }
     const auto to_move = m_rootstate.get_to_move();
     auto eval = nn_output->eval;
 
@@ -245,7 +379,8 @@ bool Search::is_uct_running() {
 }
 
 bool Search::is_over_playouts() const {
-    return m_playouts.load() < m_maxplayouts;;
+    // The visits of the reused tree count as the playouts.
+    return m_rootnode->get_visits() < m_maxplayouts;
 }
 
 int Search::select_best_move() {
@@ -273,8 +408,9 @@ void Search::clear_nodes() {
         return;
     }
 
-    delete m_rootnode;
+    // The arena owns all nodes, so free them at once.
     m_rootnode = nullptr;
+    release_tree(std::move(m_tree));
 
     // bool success = true;
 
@@ -285,22 +421,83 @@ void Search::clear_nodes() {
     // assert(success);
 }
 
+bool Search::reuse_tree(const GameState &state, const bool copy) {
+    if (m_rootnode == nullptr) {
+        return false;
+    }
+
+    const auto root_movenum = m_rootstate.get_movenum();
+    const auto movenum = state.get_movenum();
+    if (movenum < root_movenum ||
+            state.get_komi() != m_rootstate.get_komi()) {
+        return false;
+    }
+
+    // Follow the moves played since the last search.
+    auto currstate = std::make_unique<GameState>(m_rootstate);
+    auto node = m_rootnode;
+    for (auto num = root_movenum; num < movenum; ++num) {
+        const auto &record = state.get_move_record(num);
+        node = node->find_child(record.vertex);
+        if (node == nullptr || record.color != currstate->get_to_move()) {
+            return false;
+        }
+        currstate->do_move(record.vertex, record.color);
+    }
+
+    if (currstate->board.get_hash() != state.board.get_hash()) {
+        return false;
+    }
+
+    if (!copy) {
+        m_rootnode = node;
+        m_rootstate = state;
+        return true;
+    }
+
+    auto tree = create_tree();
+    m_rootnode = node->copy_subtree(tree.get(), 0, *currstate);
+    std::swap(m_tree, tree);
+    release_tree(std::move(tree));
+    m_rootstate = state;
+
+    return true;
+}
+
+std::unique_ptr<UCTTree> Search::create_tree() const {
+    auto tree = std::make_unique<UCTTree>();
+    tree->parameters = m_parameters;
+    if (m_parameters->transposition) {
+        tree->table = std::make_unique<NodeTable<UCTNode>>(4 * m_maxplayouts);
+    }
+    return tree;
+}
+
+void Search::release_tree(std::unique_ptr<UCTTree> tree) {
+    if (tree == nullptr) {
+        return;
+    }
+
+    // The task must be copyable.
+    auto shared_tree = std::shared_ptr<UCTTree>(std::move(tree));
+    m_reclaim_pool->add_task([released = std::move(shared_tree)]() mutable {
+        released.reset();
+    });
+}
+
 void Search::play_simulation(GameState &currstate, UCTNode *const node,
                              UCTNode *const root_node, SearchResult &search_result) {
     node->increment_threads();
 
-    if (node->expandable()) {
-
-        auto endsearch = EndGameSearch(currstate, option<int>("endgame_search"));
-
+    if (node != root_node && node->is_proven()) {
+        // The result is known. Back it up without searching.
+        search_result.from_proven_node(*node);
+    } else if (node->expandable()) {
         if (currstate.get_passes() >= 2) {
             search_result.from_score(currstate);
             node->from_nn_output(search_result.nn_output());
-        } else if (endsearch.valid()) {
-             search_result.from_endsearch(currstate,
-                                          endsearch,
-                                          m_endgame_cache);
-             node->from_nn_output(search_result.nn_output());
+        } else if (probe_endgame(currstate, search_result, true)) {
+            node->from_nn_output(search_result.nn_output());
         } else {
             std::shared_ptr<NNOutput> nn_output;
             const bool had_children = node->has_children();
@@ -310,20 +507,34 @@ void Search::play_simulation(GameState &currstate, UCTNode *const node,
                 search_result.from_nn_output(nn_output);
             }
         }
+    } else if (node != root_node && node->has_children()) {
+        // The solver threads may finish the position after it was
+        // expanded. Use the solved result from now on.
+        if (probe_endgame(currstate, search_result, false)) {
+            node->from_nn_output(search_result.nn_output());
+        }
     }
 
     if (node->has_children() && !search_result.valid()) {
 
         const int color = currstate.get_to_move();
-        auto next = node->uct_select_child(color, node == root_node);
-        auto move = next->get_vertex();
-        currstate.play_move(move, color);
+        const auto idx = node->uct_select_child(color, node == root_node);
+        const auto move = node->get_children().get_vertex(idx);
+        currstate.do_move(move, color);
+        auto next = node->link_child(idx, currstate);
 
         if (move != Board::PASS && currstate.superko()) {
             next->invalinode();
         } else {
             play_simulation(currstate, next, root_node, search_result);
+            if (search_result.valid()) {
+                node->update_edge(idx);
+            }
+            if (next->is_proven()) {
+                node->update_proof();
+            }
         }
+        currstate.undo_move();
     }
 
     if (search_result.valid()) {
@@ -334,6 +545,163 @@ void Search::play_simulation(GameState &currstate, UCTNode *const node,
     node->decrement_threads();
 }
 
+void Search::play_simulations(GameState &currstate, UCTNode *const root_node,
+                              SearchBatch &batch) {
+    // The paths of the collected leaves keep the virtual loss, so the
+    // later descents go to the other moves.
+    auto &states = batch.states;
+    states.clear();
+    for (auto &leaf : batch.leaves) {
+        descend(currstate, root_node, leaf);
+        if (leaf.expanding) {
+            states.emplace_back(&leaf.state);
+        }
+    }
+
+    m_evaluation.network_eval_batch(states, batch.evals, batch.buffer);
+
+    auto next_eval = std::begin(batch.evals);
+    for (auto &leaf : batch.leaves) {
+        if (leaf.expanding) {
+            std::shared_ptr<NNOutput> nn_output;
+            leaf.expanding->expend_children(*next_eval++, leaf.state, nn_output,
+                                            get_min_psa_ratio());
+            leaf.result.from_nn_output(nn_output);
+        }
+        back_up(leaf);
+        if (leaf.result.valid()) {
+            increment_playouts();
+        }
+    }
+}
+
+void Search::descend(GameState &currstate, UCTNode *const root_node, SearchLeaf &leaf) {
+    leaf.path.clear();
+    leaf.edges.clear();
+    leaf.expanding = nullptr;
+    leaf.result = SearchResult{};
+
+    // The same steps as play_simulation, but the node to expand is only
+    // acquired here. It is evaluated with the other leaves.
+    auto node = root_node;
+    while (true) {
+        node->increment_threads();
+        leaf.path.emplace_back(node);
+
+        if (node != root_node && node->is_proven()) {
+            leaf.result.from_proven_node(*node);
+        } else if (node->expandable()) {
+            if (currstate.get_passes() >= 2) {
+                leaf.result.from_score(currstate);
+                node->from_nn_output(leaf.result.nn_output());
+            } else if (probe_endgame(currstate, leaf.result, true)) {
+                node->from_nn_output(leaf.result.nn_output());
+            } else if (node->acquire_expanding()) {
+                leaf.expanding = node;
+                leaf.state = currstate;
+            }
+        } else if (node != root_node && node->has_children()) {
+            if (probe_endgame(currstate, leaf.result, false)) {
+                node->from_nn_output(leaf.result.nn_output());
+            }
+        }
+
+        if (leaf.result.valid() || leaf.expanding || !node->has_children()) {
+            break;
+        }
+
+        const int color = currstate.get_to_move();
+        const auto idx = node->uct_select_child(color, node == root_node);
+        const auto move = node->get_children().get_vertex(idx);
+        currstate.do_move(move, color);
+        leaf.edges.emplace_back(idx);
+
+        const auto next = node->link_child(idx, currstate);
+        if (move != Board::PASS && currstate.superko()) {
+            next->invalinode();
+            break;
+        }
+        node = next;
+    }
+
+    // Take back the moves, so the next descent starts from the root.
+    for (auto i = size_t{0}; i < leaf.edges.size(); ++i) {
+        currstate.undo_move();
+    }
+}
+
+void Search::back_up(SearchLeaf &leaf) {
+    const auto valid = leaf.result.valid();
+    for (auto i = leaf.path.size(); i-- > 0;) {
+        const auto node = leaf.path[i];
+        if (i + 1 < leaf.path.size()) {
+            const auto next = leaf.path[i + 1];
+            if (valid) {
+                node->update_edge(leaf.edges[i]);
+            }
+            if (next->is_proven()) {
+                node->update_proof();
+            }
+        }
+        if (valid) {
+            node->update(leaf.result.nn_output());
+        }
+        node->decrement_threads();
+    }
+}
+
+bool Search::probe_endgame(GameState &state, SearchResult &search_result,
+                           const bool solve) {
+
+    const auto exact_cnt = m_parameters->endgame_search;
+    const auto wld_cnt = m_parameters->endgame_wld_search;
+    const auto num_empty = state.board.get_numempty();
+
+    if (num_empty > exact_cnt && num_empty > wld_cnt) {
+        return false;
+    }
+
+    // The same rule as the solver uses to choose the mode.
+    const auto wld = num_empty > exact_cnt;
+
+    auto result = EndGameSearch::Result{};
+    if (m_endgame_cache.prob_cache(&state, wld, result)) {
+        search_result.from_endgame_result(result);
+        return true;
+    }
+
+    if (!solve) {
+        return false;
+    }
+
+    if (m_endgame_pool) {
+        // Only the first thread queues the position. All threads keep
+        // on searching with the network until it is solved. If the queue
+        // is full, the position is queued again on a later visit.
+        if (m_endgame_cache.acquire_pending(&state, wld, m_endgame_max_pending)) {
+            auto solve_state = std::make_shared<GameState>(state);
+            const auto generation = m_endgame_generation.load();
+            m_endgame_pool->add_task([this, solve_state, exact_cnt, wld_cnt, wld, generation]() {
+                // Drop it if the search which queued it is over.
+                if (generation == m_endgame_generation.load()) {
+                    auto endsearch = EndGameSearch(*solve_state, exact_cnt, wld_cnt);
+                    auto solved = endsearch.search();
+                    m_endgame_cache.insert_cache(solve_state.get(), solved);
+                }
+                m_endgame_cache.release_pending(solve_state.get(), wld);
+            });
+        }
+        return false;
+    }
+
+    auto endsearch = EndGameSearch(state, exact_cnt, wld_cnt);
+    result = endsearch.search();
+    m_endgame_cache.insert_cache(&state, result);
+    search_result.from_endgame_result(result);
+
+    return true;
+}
+
 float Search::get_min_psa_ratio() {
     auto v = m_playouts.load();
     if (v >= MAX_PLAYOUYS) {
@@ -362,5 +730,6 @@ bool Search::is_in_time(const float max_time) {
 
 Search::~Search() {
     set_running(false);
+    m_threadGroup->wait_all();
     clear_nodes();
 }
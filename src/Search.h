@@ -3,6 +3,8 @@
 
 #include <memory>
 #include <functional>
+#include <utility>
+#include <vector>
 
 #include "EndGameSearch.h"
 #include "SearchParameters.h"
@@ -56,20 +58,20 @@ public:
         }
     }
 
-    void from_endsearch(GameState &state,
-                        EndGameSearch &endsearch,
-                        EndGameCache &cache) {
+    void from_endgame_result(const EndGameSearch::Result &result) {
 
         m_nn_outout = std::make_shared<NNOutput>();
 
-        auto result = EndGameSearch::Result{};
-        const auto success = cache.prob_cache(&state, result);
-        if (!success) {
-            result = endsearch.search();
-            cache.insert_cache(&state, result);
-        }
-
         const auto board_score = result.score_with_komi;
+        if (result.wld) {
+            // Only the winner is known, so only the eval is backed up.
+            m_nn_outout->eval = board_score > 0.0f ? 1.0f :
+                                    board_score < 0.0f ? 0.0f : 0.5f;
+            m_nn_outout->final_score = 0.0f;
+            m_nn_outout->ownership.fill(0.0f);
+            m_nn_outout->proof_only = true;
+            return;
+        }
 
         if (board_score > 0.0f) {
             m_nn_outout->eval = 1.0f;
@@ -96,14 +98,61 @@ public:
         }
     }
 
+    void from_proven_node(const UCTNode &node) {
+        m_nn_outout = std::make_shared<NNOutput>();
+
+        const auto proof = node.get_proof(Board::BLACK);
+        if (proof == UCTNode::Proof::WIN) {
+            m_nn_outout->eval = 1.0f;
+        } else if (proof == UCTNode::Proof::LOSS) {
+            m_nn_outout->eval = 0.0f;
+        } else {
+            m_nn_outout->eval = 0.5f;
+        }
+
+        m_nn_outout->final_score = node.get_proven_score(Board::BLACK);
+        m_nn_outout->ownership = node.get_ownership(Board::BLACK);
+        m_nn_outout->proof_only = node.is_proof_only();
+    }
+
 private:
     std::shared_ptr<NNOutput> m_nn_outout{nullptr};
 
 };
 
+// One leaf of the batched simulations. The path from the root to the
+// leaf stays under the virtual loss until the leaf is backed up.
+struct SearchLeaf {
+    std::vector<UCTNode *> path;
+    std::vector<size_t> edges;
+    // The node acquired for expanding and its position. It is nullptr
+    // if the leaf needs no network evaluation. Only the board and its
+    // history are kept, not the whole game.
+    UCTNode *expanding{nullptr};
+    Position state;
+    SearchResult result;
+};
+
+// The leaves of one search thread and the storage of their evaluation.
+// Each thread makes it once, so the batches allocate nothing.
+struct SearchBatch {
+    explicit SearchBatch(const size_t size) : leaves(size) {}
+
+    std::vector<SearchLeaf> leaves;
+    std::vector<const Position *> states;
+    std::vector<Evaluation::NNeval> evals;
+    Network::BatchBuffer buffer;
+};
+
 class Search {
 public:
     static constexpr int MAX_PLAYOUYS = 150000;
+
+    // The dropped passes of each threads count in the benchmark.
+    static constexpr int BENCHMARK_WARMUP_PASSES = 2;
+
+    // The queued positions of each solver thread are not more than it.
+    static constexpr int ENDGAME_TASKS_PER_THREAD = 4;
     Search() = delete;
     Search(GameState &state, Evaluation &evaluation, Trainer &trainer);
     ~Search();
@@ -116,6 +165,11 @@ public:
 
     void prepare_uct_search();
 
+    // Search the current position with 1, 2, 4, ... threads. Return the
+    // playouts per second of each threads count. Each count runs after its
+    // own warm-up passes, so they all hit the NN cache.
+    std::vector<std::pair<int, float>> uct_benchmark(const int playouts);
+
 private:
     int nn_direct_output();
     int random_move(bool allow_pass);
@@ -125,6 +179,19 @@ private:
     void play_simulation(GameState &currstate, UCTNode *const node,
                        UCTNode *const root_node, SearchResult &search_result);
 
+    // Descend once for each leaf, evaluate the leaves in one batch and
+    // back up all of them.
+    void play_simulations(GameState &currstate, UCTNode *const root_node,
+                          SearchBatch &batch);
+    void descend(GameState &currstate, UCTNode *const root_node, SearchLeaf &leaf);
+    void back_up(SearchLeaf &leaf);
+
+    // Get the result of the end-game solver from the cache. If it is not
+    // there and solve is set, solve it on this thread, or queue it to the
+    // solver threads and return false.
+    bool probe_endgame(GameState &state, SearchResult &search_result,
+                       const bool solve);
+
     void updata_root(UCTNode *root_node);
     void set_playout(int playouts);
     bool is_stop_uct_search() const;
@@ -134,6 +201,18 @@ private:
     bool is_uct_running();
 
     void clear_nodes();
+
+    // Make the node of the state the root if it is in the tree. The
+    // subtree is copied into a new tree, and the rest is freed. If copy
+    // is not set, the root only moves to the node, so it is fast but the
+    // rest is kept until the next copy.
+    bool reuse_tree(const GameState &state, const bool copy = true);
+
+    std::unique_ptr<UCTTree> create_tree() const;
+
+    // Free the tree on the reclaimer thread, so the search never waits
+    // for it.
+    void release_tree(std::unique_ptr<UCTTree> tree);
     int select_best_move();
 
     bool is_over_playouts() const;
@@ -150,7 +229,17 @@ private:
     std::atomic<int> m_playouts;
     Timer m_timer;
     std::shared_ptr<SearchParameters> m_parameters{nullptr};
+    std::unique_ptr<UCTTree> m_tree{nullptr};
 
+    // The solved results stay valid across the moves, so the cache is
+    // kept. The tasks queued by an older search are dropped.
     EndGameCache m_endgame_cache;
+    std::atomic<int> m_endgame_generation{0};
+    size_t m_endgame_max_pending{0};
+
+    // It must be destroyed before the cache.
+    std::unique_ptr<ThreadPool> m_endgame_pool{nullptr};
+
+    std::unique_ptr<ThreadPool> m_reclaim_pool{nullptr};
 };
 #endif
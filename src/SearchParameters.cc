@@ -7,7 +7,14 @@ SearchParameters::SearchParameters() {
     playouts           = option<int>("playouts");
 
     random_min_visits = option<int>("random_min_visits");
+    endgame_search    = option<int>("endgame_search");
+    endgame_wld_search = option<int>("endgame_wld_search");
+    ownership_depth    = option<int>("ownership_depth");
+    symmetry_depth     = option<int>("symmetry_depth");
+    leaf_batch         = option<int>("leaf_batch");
     dirichlet_noise   = option<bool>("dirichlet_noise");
+    reuse_tree        = option<bool>("reuse_tree");
+    transposition     = option<bool>("transposition");
     ponder            = option<bool>("ponder");
     collect           = option<bool>("collect");
 
@@ -10,8 +10,15 @@ public:
     float allowed_pass_ratio;
     int playouts;
     int random_min_visits;
+    int endgame_search;
+    int endgame_wld_search;
+    int ownership_depth;
+    int symmetry_depth;
+    int leaf_batch;
 
     bool dirichlet_noise;
+    bool reuse_tree;
+    bool transposition;
     bool ponder;
     bool collect;
 
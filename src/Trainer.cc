@@ -106,34 +106,53 @@ bool gather_probabilities(GameState &state, UCTNode &node, std::vector<float> &p
     auto tot_visits = size_t{0};
 
     node.inflate_all_children();
-    const auto children = node.get_children();
-  
-    for (const auto &child : children) {
-        const auto vertex = child->get()->get_vertex();
-        const auto visits = child->get()->get_visits();
-        int idx = Board::NO_INDEX;
-        if (vertex == Board::PASS) {
-            idx = intersections;
-        } else {
-            const auto x = state.board.get_x(vertex);
-            const auto y = state.board.get_y(vertex);
-            idx = state.board.get_index(x, y);
+    const auto &children = node.get_children();
+
+    auto child_vertices = std::vector<int>{};
+    for (auto i = size_t{0}; i < children.size(); ++i) {
+        child_vertices.emplace_back(children.get(i)->get_vertex());
+    }
+    const auto is_child = [&](const int vertex) {
+        return std::find(std::begin(child_vertices),
+                         std::end(child_vertices), vertex) != std::end(child_vertices);
+    };
+
+    for (auto i = size_t{0}; i < children.size(); ++i) {
+        const auto child = children.get(i);
+        const auto vertex = child->get_vertex();
+        const auto visits = child->get_visits();
+
+        // The symmetric moves folded into the child are not the children,
+        // so its visits are spread evenly over them.
+        auto moves = std::vector<int>{};
+        for (const auto vtx : UCTNode::get_symmetric_moves(state, vertex)) {
+            if (vtx == vertex || !is_child(vtx)) {
+                moves.emplace_back(vtx);
+            }
         }
 
+        auto visits_with_temperature = double{0.0f};
         if (visits > 1) {
             const double exponent = 1.0f / temperature;
-            const double visits_with_temperature = 
-                             std::pow(static_cast<double>(visits), exponent);
+            visits_with_temperature =
+                std::pow(static_cast<double>(visits), exponent);
 
             tot_visits += visits;
             factor += visits_with_temperature;
-            probabilities[idx] = visits_with_temperature;
-        } else {
-            tot_visits += 0;
-            factor += 0;
-            probabilities[idx] = 0;
         }
-        assert(idx != Board::NO_INDEX);
+
+        for (const auto vtx : moves) {
+            int idx = Board::NO_INDEX;
+            if (vtx == Board::PASS) {
+                idx = intersections;
+            } else {
+                const auto x = state.board.get_x(vtx);
+                const auto y = state.board.get_y(vtx);
+                idx = state.board.get_index(x, y);
+            }
+            assert(idx != Board::NO_INDEX);
+            probabilities[idx] = visits_with_temperature / moves.size();
+        }
     }
     if (tot_visits == 0) {
         return false;
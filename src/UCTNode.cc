@@ -17,19 +17,45 @@
 #include <utility>
 #include <vector>
 
-UCTNode::UCTNode(std::shared_ptr<UCTData> data) {
-    m_data = data;
-    assert(m_data->parameters);
-    m_accumulated_black_ownership.fill(0.0f);
-    m_raw_black_ownership.fill(0.0f);
+static_assert(Board::PASS <= 0xff, "The vertex of the child must fit in 8 bits!\n");
+
+UCTNode::UCTNode(UCTTree *tree, const int vertex, const float policy, const int depth) {
+    m_tree = tree;
+    m_vertex = vertex;
+    m_policy = policy;
+    m_depth = depth;
+    assert(depth >= 0 && depth <= 0xffff);
+    assert(m_tree->parameters);
+    m_raw_black_ownership.fill(0);
+
+    if (m_depth < parameters()->ownership_depth) {
+        m_accumulated_black_ownership =
+            m_tree->arena.allocate_array<std::atomic<std::int64_t>>(NUM_INTERSECTIONS);
+        for (auto idx = size_t{0}; idx < NUM_INTERSECTIONS; ++idx) {
+            new (&m_accumulated_black_ownership[idx]) std::atomic<std::int64_t>(0);
+        }
+    }
+}
+
+std::int64_t UCTNode::to_fixed(const double value, const double scale) {
+    const auto fixed = value * scale;
+    return static_cast<std::int64_t>(fixed >= 0.0 ? fixed + 0.5 : fixed - 0.5);
 }
 
-UCTNode::~UCTNode() {
-    assert(m_loading_threads.load() == 0);
+UCTNode *UCTNode::inflate_child(const size_t idx) {
+    return m_children.inflate(idx, m_tree, m_depth + 1);
 }
 
-std::shared_ptr<SearchParameters> UCTNode::parameters() const {
-    return m_data->parameters;
+void UCTNode::set_raw_ownership(const std::array<float, NUM_INTERSECTIONS> &ownership) {
+    for (auto idx = size_t{0}; idx < NUM_INTERSECTIONS; ++idx) {
+        const auto owner = std::max(-1.0f, std::min(ownership[idx], 1.0f));
+        m_raw_black_ownership[idx] =
+            static_cast<std::int16_t>(std::round(owner * OWNERSHIP_SCALE));
+    }
+}
+
+const SearchParameters *UCTNode::parameters() const {
+    return m_tree->parameters.get();
 }
 
 bool UCTNode::expend_children(Evaluation &evaluation,
@@ -43,33 +69,38 @@ bool UCTNode::expend_children(Evaluation &evaluation,
         return false;
     }
 
-    const size_t boardsize = (size_t)state.get_boardsize();
-    const size_t intersections = (size_t)state.get_intersections();
-
-    auto raw_netlist =
+    const auto raw_netlist =
         evaluation.network_eval(state, Network::Ensemble::RANDOM_SYMMETRY);
 
+    expend_children(raw_netlist, state, nn_output, min_psa_ratio);
+
+    return true;
+}
+
+void UCTNode::expend_children(const Evaluation::NNeval &raw_netlist,
+                              Position &state,
+                              std::shared_ptr<NNOutput> &nn_output,
+                              const float min_psa_ratio) {
+
+    assert(state.get_passes() < 2);
+    assert(m_expand_state.load() == ExpandState::EXPANDING);
+
     m_color = state.get_to_move();
     link_nn_output(state, raw_netlist, nn_output, m_color);
 
     auto nodelist = std::vector<Network::PolicyVertexPair>{};
     float legal_accumulate = 0.0f;
 
-    for (auto i = size_t{0}; i < intersections; i++) {
-        const auto x = i % boardsize;
-        const auto y = i / boardsize;
-        const auto vertex = state.get_vertex(x, y);
-        const auto policy = raw_netlist.policy[i];
-
-        if (state.is_legal(vertex, m_color)) {
-            nodelist.emplace_back(policy, vertex);
-            legal_accumulate += policy;
+    const auto movelist = state.board.get_movelist(m_color);
+    for (const auto vertex : movelist) {
+        auto policy = raw_netlist.policy_pass;
+        if (vertex != Board::PASS) {
+            const auto x = state.get_x(vertex);
+            const auto y = state.get_y(vertex);
+            policy = raw_netlist.policy[state.get_index(x, y)];
         }
-    }
-
-    if (nodelist.empty() && state.is_legal(Board::PASS, m_color)) {
-        nodelist.emplace_back(raw_netlist.policy_pass, Board::PASS);
-        legal_accumulate += raw_netlist.policy_pass;
+        nodelist.emplace_back(policy, vertex);
+        legal_accumulate += policy;
     }
 
     assert(legal_accumulate != 0.0f);
@@ -78,10 +109,12 @@ bool UCTNode::expend_children(Evaluation &evaluation,
         node.first /= legal_accumulate;
     }
 
+    if (m_depth < parameters()->symmetry_depth) {
+        fold_symmetric_moves(state, nodelist);
+    }
+
     link_nodelist(nodelist, min_psa_ratio);
     expand_done();
-
-    return true;
 }
 
 void UCTNode::link_nodelist(std::vector<Network::PolicyVertexPair> &nodelist, float min_psa_ratio) {
@@ -89,21 +122,81 @@ void UCTNode::link_nodelist(std::vector<Network::PolicyVertexPair> &nodelist, fl
     std::stable_sort(rbegin(nodelist), rend(nodelist));
 
     const float min_psa = nodelist[0].first * min_psa_ratio;
+    auto children_size = size_t{0};
     for (const auto &node : nodelist) {
         if (node.first < min_psa) {
             break;
-        } else {
-            auto data = std::make_shared<UCTData>();
-            data->vertex = node.second;
-            data->policy = node.first;
-            data->parameters = parameters();
-            m_children.emplace_back(std::move(std::make_shared<UCTNodePointer>(data)));
         }
+        children_size++;
+    }
+
+    m_partial_children = children_size < nodelist.size();
+    m_children.initialize(m_tree, children_size, m_tree->table != nullptr);
+    for (auto idx = size_t{0}; idx < children_size; ++idx) {
+        m_children.set(idx, nodelist[idx].second, nodelist[idx].first);
     }
     assert(!m_children.empty());
 }
 
-void UCTNode::link_nn_output(GameState &state,
+std::vector<int> UCTNode::get_symmetric_moves(const Position &state, const int vertex) {
+    auto moves = std::vector<int>{vertex};
+    if (vertex == Board::PASS) {
+        return moves;
+    }
+
+    const auto hash = state.board.get_hash();
+    for (int sym = 0; sym < Board::NUM_SYMMETRIES; ++sym) {
+        if (state.board.get_symmetry_hash(sym) != hash) {
+            continue;
+        }
+        const auto sym_vtx = state.board.get_transform_vtx(vertex, sym);
+        if (std::find(std::begin(moves), std::end(moves), sym_vtx) == std::end(moves)) {
+            moves.emplace_back(sym_vtx);
+        }
+    }
+    return moves;
+}
+
+void UCTNode::fold_symmetric_moves(const Position &state,
+                                   std::vector<Network::PolicyVertexPair> &nodelist) {
+    const auto hash = state.board.get_hash();
+    auto symmetric = false;
+    for (int sym = 0; sym < Board::NUM_SYMMETRIES; ++sym) {
+        if (sym != Board::IDENTITY_SYMMETRY &&
+                state.board.get_symmetry_hash(sym) == hash) {
+            symmetric = true;
+        }
+    }
+
+    if (!symmetric) {
+        return;
+    }
+
+    // The symmetric moves share the smallest one.
+    const auto get_class = [&](const int vertex) {
+        const auto moves = get_symmetric_moves(state, vertex);
+        return *std::min_element(std::begin(moves), std::end(moves));
+    };
+
+    auto folded = std::vector<std::pair<int, Network::PolicyVertexPair>>{};
+    for (const auto &node : nodelist) {
+        const auto cls = get_class(node.second);
+        auto res = std::find_if(std::begin(folded), std::end(folded),
+                                [cls](const auto &f) { return f.first == cls; });
+        if (res == std::end(folded)) {
+            folded.emplace_back(cls, node);
+        } else {
+            res->second.first += node.first;
+        }
+    }
+
+    nodelist.clear();
+    for (const auto &f : folded) {
+        nodelist.emplace_back(f.second);
+    }
+}
+
+void UCTNode::link_nn_output(Position &state,
                              const Evaluation::NNeval &raw_netlist,
                              std::shared_ptr<NNOutput> &nn_output, const int color){
 
@@ -118,16 +211,21 @@ void UCTNode::link_nn_output(GameState &state,
         m_raw_black_eval = stm_eval;
     }
 
+    if (!nn_output) {
+        nn_output=std::make_shared<NNOutput>();
+    }
+
     // ownership
-    m_raw_black_ownership.fill(0.0f);
+    nn_output->ownership.fill(0.0f);
     for (auto idx = size_t{0}; idx < intersections; ++idx) {
         const float ownership = raw_netlist.ownership[idx];
         if (color == Board::WHITE) {
-            m_raw_black_ownership[idx] = 0.0f - ownership;
+            nn_output->ownership[idx] = 0.0f - ownership;
         } else {
-            m_raw_black_ownership[idx] = ownership;
+            nn_output->ownership[idx] = ownership;
         }
     }
+    set_raw_ownership(nn_output->ownership);
 
     // final score
     if (color == Board::WHITE) {
@@ -135,10 +233,6 @@ void UCTNode::link_nn_output(GameState &state,
     } else {
         m_raw_black_final_score = raw_netlist.final_score;
     }
-    if (!nn_output) {
-        nn_output=std::make_shared<NNOutput>();
-    }
-    std::copy(m_raw_black_ownership.begin(), m_raw_black_ownership.end(), nn_output->ownership.begin());
     nn_output->final_score = m_raw_black_final_score;
     nn_output->eval = m_raw_black_eval;
 }
@@ -147,12 +241,201 @@ void UCTNode::from_nn_output(std::shared_ptr<NNOutput> nn_output) {
     if (nn_output && !m_terminal.load()) {
         // This node is double pass node.
         m_terminal.store(true);
-        std::copy(nn_output->ownership.begin(), nn_output->ownership.end(), m_raw_black_ownership.begin());
-        m_raw_black_final_score = nn_output->final_score;
+        if (!nn_output->proof_only) {
+            set_raw_ownership(nn_output->ownership);
+            m_raw_black_final_score = nn_output->final_score;
+        }
         m_raw_black_eval = nn_output->eval;
+
+        auto proof = Proof::DRAW;
+        if (nn_output->eval > 0.5f) {
+            proof = Proof::WIN;
+        } else if (nn_output->eval < 0.5f) {
+            proof = Proof::LOSS;
+        }
+        set_proof(Board::BLACK, proof, nn_output->final_score, nn_output->proof_only);
     }
 }
 
+bool UCTNode::is_proven() const {
+    return m_black_proof.load(std::memory_order_acquire) != Proof::NONE;
+}
+
+bool UCTNode::is_proof_only() const {
+    return m_proof_only.load(std::memory_order_relaxed);
+}
+
+UCTNode::Proof UCTNode::get_proof(const int color) const {
+    const auto proof = m_black_proof.load(std::memory_order_acquire);
+    if (color == Board::WHITE) {
+        if (proof == Proof::WIN) {
+            return Proof::LOSS;
+        } else if (proof == Proof::LOSS) {
+            return Proof::WIN;
+        }
+    }
+    return proof;
+}
+
+float UCTNode::get_proven_score(const int color) const {
+    const auto score = m_proven_black_score.load(std::memory_order_relaxed);
+    if (color == Board::BLACK) {
+        return score;
+    }
+    return 0.0f - score;
+}
+
+void UCTNode::set_proof(const int color, const Proof proof,
+                        const float score, const bool proof_only) {
+    auto black_proof = proof;
+    auto black_score = score;
+    if (color == Board::WHITE) {
+        if (proof == Proof::WIN) {
+            black_proof = Proof::LOSS;
+        } else if (proof == Proof::LOSS) {
+            black_proof = Proof::WIN;
+        }
+        black_score = 0.0f - score;
+    }
+    m_proven_black_score.store(black_score, std::memory_order_relaxed);
+    m_proof_only.store(proof_only, std::memory_order_relaxed);
+    m_black_proof.store(black_proof, std::memory_order_release);
+}
+
+size_t UCTNode::get_best_proven_child(const int color) const {
+    // The win is better than the draw, and the draw is better than
+    // the loss. The higher score is better for the same proof, and a
+    // proof without the score comes after the scored ones.
+    const auto rank = [](const Proof proof) {
+        if (proof == Proof::WIN) {
+            return 2;
+        } else if (proof == Proof::DRAW) {
+            return 1;
+        }
+        return 0;
+    };
+
+    auto best_idx = m_children.size();
+    auto best_rank = 0;
+    auto best_score = std::numeric_limits<float>::lowest();
+
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const auto child = m_children.get(idx);
+        if (!child || !child->is_active() || !child->is_proven()) {
+            continue;
+        }
+        const auto child_rank = rank(child->get_proof(color));
+        const auto child_score = child->is_proof_only() ?
+                                     std::numeric_limits<float>::lowest() :
+                                     child->get_proven_score(color);
+        if (best_idx == m_children.size() || child_rank > best_rank ||
+                (child_rank == best_rank && child_score > best_score)) {
+            best_idx = idx;
+            best_rank = child_rank;
+            best_score = child_score;
+        }
+    }
+    return best_idx;
+}
+
+void UCTNode::update_proof() {
+    if (is_proven() || !is_expended()) {
+        return;
+    }
+
+    auto all_proven = !m_partial_children;
+    for (auto idx = size_t{0}; all_proven && idx < m_children.size(); ++idx) {
+        const auto child = m_children.get(idx);
+        if (!child || (child->is_valid() && !child->is_proven())) {
+            all_proven = false;
+        }
+    }
+
+    const auto best_idx = get_best_proven_child(m_color);
+    if (best_idx == m_children.size()) {
+        return;
+    }
+
+    const auto child = m_children.get(best_idx);
+    const auto proof = child->get_proof(m_color);
+    if (proof == Proof::WIN || all_proven) {
+        set_proof(m_color, proof, child->get_proven_score(m_color),
+                  child->is_proof_only());
+    }
+}
+
+int UCTNode::get_proven_move() const {
+    if (!is_proven()) {
+        return Board::NO_VERTEX;
+    }
+    const auto idx = get_best_proven_child(m_color);
+    if (idx == m_children.size()) {
+        return Board::NO_VERTEX;
+    }
+    return m_children.get_vertex(idx);
+}
+
+UCTNode *UCTNode::copy_subtree(UCTTree *tree, const int depth, GameState &state) const {
+    assert(get_threads() == 0 && !is_expending());
+
+    // Only the node in the table is shared. The other nodes of the same
+    // position have their own visits, so they keep their own copies.
+    const auto hash = state.board.get_hash();
+    const auto shared = tree->table && m_tree->table &&
+                            m_tree->table->lookup(hash) == this;
+
+    // The node is copied already from another path.
+    if (shared) {
+        if (const auto copied = tree->table->lookup(hash)) {
+            return copied;
+        }
+    }
+
+    auto node = tree->arena.create<UCTNode>(tree, m_vertex, m_policy, depth);
+    if (shared) {
+        tree->table->insert(hash, node);
+    }
+
+    node->m_color = m_color;
+    node->m_raw_black_eval = m_raw_black_eval;
+    node->m_raw_black_final_score = m_raw_black_final_score;
+    node->m_raw_black_ownership = m_raw_black_ownership;
+    node->m_terminal.store(m_terminal.load());
+
+    const auto visits = get_visits();
+    node->m_accumulated_black_evals.store(m_accumulated_black_evals.load());
+    node->m_accumulated_squared_evals.store(m_accumulated_squared_evals.load());
+    node->m_accumulated_black_finalscore.store(m_accumulated_black_finalscore.load());
+    node->m_status.store(m_status.load());
+    node->m_partial_children = m_partial_children;
+    node->m_proven_black_score.store(m_proven_black_score.load());
+    node->m_proof_only.store(m_proof_only.load());
+    node->m_black_proof.store(m_black_proof.load());
+
+    // The node may accumulate the ownership in the new tree but not in
+    // this one. Start it from the current average.
+    if (node->m_accumulated_black_ownership) {
+        const auto ownership = get_ownership(Board::BLACK);
+        for (auto idx = size_t{0}; idx < NUM_INTERSECTIONS; ++idx) {
+            node->m_accumulated_black_ownership[idx].store(
+                to_fixed(static_cast<double>(ownership[idx]) * visits, EVAL_SCALE));
+        }
+    }
+    node->m_visits.store(visits);
+
+    if (is_expended()) {
+        node->m_children.copy(tree, m_children, [&](const size_t idx, const UCTNode *child) {
+            state.do_move(m_children.get_vertex(idx), m_color);
+            const auto copied = child->copy_subtree(tree, depth + 1, state);
+            state.undo_move();
+            return copied;
+        });
+        node->m_expand_state.store(ExpandState::EXPANDED);
+    }
+
+    return node;
+}
+
 float UCTNode::get_raw_evaluation(const int color) const {
     if (color == Board::BLACK) {
         return m_raw_black_eval;
@@ -162,19 +445,23 @@ float UCTNode::get_raw_evaluation(const int color) const {
 }
 
 int UCTNode::get_vertex() const {
-    return m_data->vertex;
+    return m_vertex;
 }
 
 float UCTNode::get_policy() const {
-    return m_data->policy;
+    return m_policy;
 }
 
 int UCTNode::get_visits() const {
     return m_visits.load();
 }
 
+int UCTNode::get_depth() const {
+    return m_depth;
+}
+
 float UCTNode::get_accumulated_evals() const {
-    return m_accumulated_black_evals.load();
+    return static_cast<float>(m_accumulated_black_evals.load()) / static_cast<float>(EVAL_SCALE);
 }
 
 int UCTNode::get_color() const {
@@ -228,7 +515,8 @@ float UCTNode::get_final_score(const int color) const {
         return 0.0f;
     }
 
-    const auto final_score = m_accumulated_black_finalscore.load() / visits;
+    const auto final_score = static_cast<float>(m_accumulated_black_finalscore.load()) /
+                                 (static_cast<float>(SCORE_SCALE) * visits);
     if (color == Board::BLACK) {
         return final_score;
     }
@@ -241,14 +529,15 @@ int UCTNode::get_most_visits_move() {
 
     int most_visits = std::numeric_limits<int>::lowest();
     int most_vertex = Board::NO_VERTEX;
-    for (const auto &child : m_children) {
-        if (!child->get()) {
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const auto child = m_children.get(idx);
+        if (!child) {
             continue;
         }
 
-        const int node_visits = child->get()->get_visits();
+        const int node_visits = child->get_visits();
         if (node_visits > most_visits) {
-            most_vertex = child->get()->get_vertex();
+            most_vertex = m_children.get_vertex(idx);
             most_visits = node_visits;
         }
     }
@@ -263,13 +552,14 @@ UCTNode *UCTNode::get_most_visits_child() {
     assert(has_children());
 
     int most_visits = std::numeric_limits<int>::lowest();
-    std::shared_ptr<UCTNodePointer> most_child = nullptr;
+    UCTNode *most_child = nullptr;
 
-    for (const auto &child : m_children) {
-        if (!child->get()) {
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const auto child = m_children.get(idx);
+        if (!child) {
             continue;
         }
-        const int node_visits = child->get()->get_visits();
+        const int node_visits = child->get_visits();
         if (node_visits > most_visits) {
             most_visits = node_visits;
             most_child = child;
@@ -277,28 +567,38 @@ UCTNode *UCTNode::get_most_visits_child() {
     }
 
     assert(most_child != nullptr);
-    most_child->inflate();
 
-    return most_child->get();
+    return most_child;
 }
 
 UCTNode *UCTNode::get_child(const int vtx) {
     wait_expanded();
     assert(has_children());
 
-    std::shared_ptr<UCTNodePointer> res = nullptr;
+    UCTNode *res = nullptr;
 
-    for (const auto &child : m_children) { 
-        const int vertex = child->data()->vertex;
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const int vertex = m_children.get_vertex(idx);
         if (vtx == vertex) {
-            res = child;
+            res = inflate_child(idx);
             break;
         }
     }
 
     assert(res != nullptr);
-    res->inflate();
-    return res->get();
+    return res;
+}
+
+UCTNode *UCTNode::find_child(const int vtx) const {
+    if (!is_expended()) {
+        return nullptr;
+    }
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        if (m_children.get_vertex(idx) == vtx) {
+            return m_children.get(idx);
+        }
+    }
+    return nullptr;
 }
 
 int UCTNode::randomize_first_proportionally(float random_temp) {
@@ -307,9 +607,10 @@ int UCTNode::randomize_first_proportionally(float random_temp) {
     auto accum = double{0.0};
     auto accum_vector = std::vector<std::pair<double, int>>{};
 
-    for (const auto &child : m_children) {
-        const auto visits = child->get()->get_visits();
-        const auto vertex = child->get()->get_vertex();
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const auto child = inflate_child(idx);
+        const auto visits = child->get_visits();
+        const auto vertex = m_children.get_vertex(idx);
         if (visits > parameters()->random_min_visits) {
            accum += std::pow((double)visits, (1.0 / random_temp));
            accum_vector.emplace_back(std::pair<double, int>(accum, vertex));
@@ -331,10 +632,17 @@ int UCTNode::randomize_first_proportionally(float random_temp) {
 }
 
 std::array<float, NUM_INTERSECTIONS> UCTNode::get_ownership(const int color) const {
-    auto visits = get_visits();
-    auto ownership = m_accumulated_black_ownership;
-    for (auto &owner : ownership) {
-        owner /= visits;
+    auto ownership = std::array<float, NUM_INTERSECTIONS>{};
+    const auto visits = get_visits();
+    if (m_accumulated_black_ownership && visits > 0) {
+        for (auto idx = size_t{0}; idx < NUM_INTERSECTIONS; ++idx) {
+            const auto sum = m_accumulated_black_ownership[idx].load(std::memory_order_relaxed);
+            ownership[idx] = static_cast<float>(sum / (EVAL_SCALE * visits));
+        }
+    } else {
+        for (auto idx = size_t{0}; idx < NUM_INTERSECTIONS; ++idx) {
+            ownership[idx] = m_raw_black_ownership[idx] / OWNERSHIP_SCALE;
+        }
     }
 
     if (color == Board::WHITE) {
@@ -346,12 +654,21 @@ std::array<float, NUM_INTERSECTIONS> UCTNode::get_ownership(const int color) con
     return ownership;
 }
 
-const std::vector<std::shared_ptr<UCTNode::UCTNodePointer>>& UCTNode::get_children() const {
+const NodeList<UCTNode> &UCTNode::get_children() const {
     return m_children;
 }
 
 float UCTNode::get_eval_variance(float default_var) const {
-    return m_visits > 1 ? m_squared_eval_diff / (m_visits - 1) : default_var;
+    const auto visits = get_visits();
+    if (visits <= 1) {
+        return default_var;
+    }
+    // The sums are exact in fixed point, so there is no cancellation
+    // beyond the quantization.
+    const auto sum = m_accumulated_black_evals.load() / EVAL_SCALE;
+    const auto squared_sum = m_accumulated_squared_evals.load() / EVAL_SCALE;
+    const auto squared_diff = std::max(squared_sum - sum * sum / visits, 0.0);
+    return static_cast<float>((squared_diff + 1e-4) / (visits - 1));
 }
 
 float UCTNode::get_eval_lcb(const int color) const {
@@ -378,10 +695,11 @@ std::vector<std::pair<float, int>> UCTNode::get_lcb_list(const int color) {
     std::vector<std::pair<float, int>> list;
     inflate_all_children();
 
-    for (const auto & child : m_children) {
-        const auto visits = child->get()->get_visits();
-        const auto vertex = child->get()->get_vertex();
-        const auto lcb = child->get()->get_eval_lcb(color);
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const auto child = inflate_child(idx);
+        const auto visits = child->get_visits();
+        const auto vertex = m_children.get_vertex(idx);
+        const auto lcb = child->get_eval_lcb(color);
         if (visits > 0) {
             list.emplace_back(lcb, vertex);
         }
@@ -392,6 +710,12 @@ std::vector<std::pair<float, int>> UCTNode::get_lcb_list(const int color) {
 }
 
 int UCTNode::get_best_move() {
+    // Play the proven result if the node is solved.
+    const auto proven_move = get_proven_move();
+    if (proven_move != Board::NO_VERTEX) {
+        return proven_move;
+    }
+
     auto lcblist = get_lcb_list(m_color);
 
     float best_value = std::numeric_limits<float>::lowest();
@@ -408,7 +732,7 @@ int UCTNode::get_best_move() {
     }
 
     if (lcblist.empty() && has_children()) {
-        best_move = m_children[0]->get()->get_vertex();
+        best_move = m_children.get_vertex(0);
     }
 
     assert(best_move != Board::NO_VERTEX);
@@ -424,10 +748,11 @@ std::vector<std::pair<float, int>> UCTNode::get_winrate_list(const int color) {
     inflate_all_children();
     std::vector<std::pair<float, int>> list;
 
-    for (const auto &child : m_children) {
-        const auto vertex = child->get()->get_vertex();
-        const auto visits = child->get()->get_visits();
-        const auto winrate = child->get()->get_eval(color, false);
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const auto child = inflate_child(idx);
+        const auto vertex = m_children.get_vertex(idx);
+        const auto visits = child->get_visits();
+        const auto winrate = child->get_eval(color, false);
         if (visits > 0) {
             list.emplace_back(winrate, vertex);
         }
@@ -442,27 +767,7 @@ UCTNode *UCTNode::get() {
 }
 
 void UCTNode::set_policy(const float policy) {
-    m_data->policy = policy;
-}
-
-bool UCTNode::acquire_update() {
-    auto expected = ExpandState::EXPANDED;
-    auto newval = ExpandState::UPDATE;
-    return m_expand_state.compare_exchange_strong(expected, newval);
-}
-
-bool UCTNode::wait_update() {
-    while (!acquire_update()) {
-        if (m_expand_state.load() == ExpandState::INITIAL) {
-            return false;
-        }
-    }
-    return true;
-}
-
-void UCTNode::update_done() {
-    auto v = m_expand_state.exchange(ExpandState::EXPANDED);
-    assert(v == ExpandState::UPDATE);
+    m_policy = policy;
 }
 
 bool UCTNode::acquire_expanding() {
@@ -484,7 +789,7 @@ void UCTNode::expand_cancel() {
 void UCTNode::wait_expanded() {
     while (true) {
         auto v = m_expand_state.load();
-        if (v == ExpandState::EXPANDED || v == ExpandState::UPDATE) {
+        if (v == ExpandState::EXPANDED) {
             break;
         }
     }
@@ -519,8 +824,8 @@ bool UCTNode::is_valid() const {
 }
 
 void UCTNode::inflate_all_children() {
-    for (const auto &child : m_children) {
-        child->inflate();
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        inflate_child(idx);
     }
 }
 
@@ -538,10 +843,10 @@ void UCTNode::invalinode() {
 }
 
 bool UCTNode::prune_child(const int vtx) {
-    for (const auto &child : m_children) {
-        if (child->data()->vertex == vtx) {
-            child->inflate();
-            child->get()->set_active(false);
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        if (m_children.get_vertex(idx) == vtx) {
+            const auto child = inflate_child(idx);
+            child->set_active(false);
             return true;
         }
     }
@@ -574,11 +879,13 @@ void UCTNode::dirichlet_noise(float epsilon, float alpha) {
     child_cnt = 0;
     // Be Sure all node are expended.
     inflate_all_children();
-    for (const auto &child : m_children) {
-        auto policy = child->get()->get_policy();
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const auto child = inflate_child(idx);
+        auto policy = child->get_policy();
         auto eta_a = dirichlet_buffer[child_cnt++];
         policy = policy * (1 - epsilon) + epsilon * eta_a;
-        child->get()->set_policy(policy);
+        child->set_policy(policy);
+        m_children.set_policy(idx, policy);
     }
 }
 
@@ -587,11 +894,21 @@ void UCTNode::prepare_root_node(Evaluation &evaluation,
                                 std::shared_ptr<NNOutput> &nn_output) {
 
     const bool is_root = true;
-    bool success = expend_children(evaluation, state, nn_output, 0.0f, is_root);
+    bool success = true;
+    if (expandable()) {
+        success = expend_children(evaluation, state, nn_output, 0.0f, is_root);
+    }
 
     bool had_childen = has_children();
     assert(success && had_childen);
 
+    // The reused root may be proven as a leaf, by the terminal or solved
+    // result, so no move of it is proven. Search it again until a move
+    // proves it.
+    if (is_proven() && get_proven_move() == Board::NO_VERTEX) {
+        m_black_proof.store(Proof::NONE);
+    }
+
     if (success && had_childen) {
         inflate_all_children();
         size_t legal_move = m_children.size();
@@ -602,20 +919,29 @@ void UCTNode::prepare_root_node(Evaluation &evaluation,
     }
 }
 
-UCTNode *UCTNode::uct_select_child(const int color, bool is_root) {
+size_t UCTNode::uct_select_child(const int color, bool is_root) {
     wait_expanded();
     assert(has_children());
 
+    // The shared node is visited from the other parents too. Count only
+    // the visits through this node.
+    const auto edge_visits = m_children.has_edge_visits();
+    const auto child_visits = [&](const size_t idx, const UCTNode *child) {
+        return edge_visits ? m_children.get_edge_visits(idx) : child->get_visits();
+    };
+
     int parentvisits = 0;
     double total_visited_policy = 0.0f;
-    for (const auto &child : m_children) {
-        if (!child->get()) {
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const auto child = m_children.get(idx);
+        if (!child) {
             continue;
         }    
-        if (child->get()->is_valid()) {
-            parentvisits += child->get()->get_visits();
-            if (child->get()->get_visits() > 0) {
-                total_visited_policy += child->get()->get_policy();
+        if (child->is_valid()) {
+            const auto visits = child_visits(idx, child);
+            parentvisits += visits;
+            if (visits > 0) {
+                total_visited_policy += m_children.get_policy(idx);
             }
         }
     }
@@ -636,81 +962,117 @@ UCTNode *UCTNode::uct_select_child(const int color, bool is_root) {
 
     const double mean_score = get_mean_score(color);
 
-    std::shared_ptr<UCTNodePointer> best_node = nullptr;
+    auto best_idx = size_t{0};
+    auto found = false;
     double best_value = std::numeric_limits<double>::lowest();
 
-    for (const auto &child : m_children) {
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const auto child = m_children.get(idx);
         // Check the node is pointer or not.
         // If not, we can not get most data from child.
-        bool is_pointer = child->get();
+        bool is_pointer = child;
 
         // If the node was pruned. Skip this time,
-        if (is_pointer && !child->get()->is_active()) {
+        if (is_pointer && !child->is_active()) {
+            continue;
+        }
+
+        // The result of the proven node is known. Searching it again
+        // tells nothing.
+        if (is_pointer && child->is_proven()) {
             continue;
         }
 
+        const auto visits = is_pointer ? child_visits(idx, child) : 0;
         double winrate = fpu_eval + get_score_utility(color, mean_score);
         if (is_pointer) {
-            if (child->get()->is_expending()) {
+            if (child->is_expending()) {
                 winrate = -1.0f - fpu_reduction;
-            } else if (child->get()->get_visits() > 0) {
-                winrate = child->get()->get_eval(color) +
-                              child->get()->get_score_utility(color, mean_score);
+            } else if (visits > 0) {
+                winrate = child->get_eval(color) +
+                              child->get_score_utility(color, mean_score);
             }
         }   
-        double denom = 1.0;
-        if (is_pointer) {
-            denom += child->get()->get_visits();
-        }
+        double denom = 1.0 + visits;
 
-        const double psa = child->data()->policy;
+        const double psa = m_children.get_policy(idx);
         const double puct = cpuct * psa * (numerator / denom);
         const double value = winrate + puct;
         assert(value > std::numeric_limits<double>::lowest());
 
         if (value > best_value) {
             best_value = value;
-            best_node = child;
+            best_idx = idx;
+            found = true;
         }
     }
 
-    best_node->inflate();
-    return best_node->get();
-}
+    // All moves are proven, but the node isn't since some moves are
+    // cut. Back up the best one.
+    if (!found) {
+        best_idx = get_best_proven_child(color);
+        found = best_idx < m_children.size();
+    }
 
-void UCTNode::accumulate_eval(float eval) {
-    Utils::atomic_add(m_accumulated_black_evals, eval);
+    assert(found);
+    (void) found;
+
+    return best_idx;
 }
 
-void UCTNode::update(std::shared_ptr<NNOutput> nn_output) {
+UCTNode *UCTNode::link_child(const size_t idx, const GameState &state) {
+    auto &table = m_tree->table;
+    if (!table) {
+        return inflate_child(idx);
+    }
 
-    const float eval = nn_output->eval;
+    return m_children.inflate_by(idx, [&]() {
+        const auto hash = state.board.get_hash();
+        if (const auto shared = table->lookup(hash)) {
+            return shared;
+        }
+        const auto node = m_tree->arena.create<UCTNode>(m_tree,
+                                                        m_children.get_vertex(idx),
+                                                        m_children.get_policy(idx),
+                                                        m_depth + 1);
+        return table->insert(hash, node);
+    });
+}
 
-    float old_eval = m_accumulated_black_evals.load();
-    float old_visits = m_visits.load();
-    float old_delta = old_visits > 0 ? eval - old_eval / old_visits : 0.0f;
-    m_visits++;
-    Utils::atomic_add(m_accumulated_black_evals, eval);
+void UCTNode::update_edge(const size_t idx) {
+    m_children.increment_edge_visits(idx);
+}
 
-    float new_delta = eval - (old_eval + eval) / (old_visits + 1);
-    // Welford's online algorithm for calculating variance.
-    float delta = old_delta * new_delta;
-    Utils::atomic_add(m_squared_eval_diff, delta);
+void UCTNode::accumulate_ownership(const std::array<float, NUM_INTERSECTIONS> &ownership) {
+    for (auto idx = size_t{0}; idx < NUM_INTERSECTIONS; ++idx) {
+        m_accumulated_black_ownership[idx].fetch_add(
+            to_fixed(ownership[idx], EVAL_SCALE), std::memory_order_relaxed);
+    }
+}
 
-    const float final_score = nn_output->final_score;
-    Utils::atomic_add(m_accumulated_black_finalscore, final_score);
+void UCTNode::update(std::shared_ptr<NNOutput> nn_output) {
 
-    bool success = wait_update();
-    if (success || m_terminal.load()) {
-        const size_t o_size = nn_output->ownership.size();
-        for (auto idx = size_t{0}; idx < o_size; ++idx) {
-            const auto owner = nn_output->ownership[idx];
-            m_accumulated_black_ownership[idx] += owner;
-        }
-        if (success) {
-            update_done();
-        }
+    const double eval = nn_output->eval;
+    // The result without the score adds the mean of the node, so the
+    // mean stays.
+    const double final_score = nn_output->proof_only ?
+                                   get_final_score(Board::BLACK) : nn_output->final_score;
+
+    m_accumulated_black_evals.fetch_add(
+        to_fixed(eval, EVAL_SCALE), std::memory_order_relaxed);
+    m_accumulated_squared_evals.fetch_add(
+        to_fixed(eval * eval, EVAL_SCALE), std::memory_order_relaxed);
+    m_accumulated_black_finalscore.fetch_add(
+        to_fixed(final_score, SCORE_SCALE), std::memory_order_relaxed);
+
+    if (m_accumulated_black_ownership) {
+        accumulate_ownership(nn_output->proof_only ?
+                                 get_ownership(Board::BLACK) : nn_output->ownership);
     }
+
+    // Publish the sums. The readers load the visits first, so they never
+    // see a visit without its value.
+    m_visits.fetch_add(1, std::memory_order_release);
 }
 
 float UCTNode::get_mean_score(const int color) const {
@@ -4,7 +4,9 @@
 #include "SearchParameters.h"
 #include "Evaluation.h"
 #include "GameState.h"
+#include "NodeArena.h"
 #include "NodePointer.h"
+#include "NodeTable.h"
 #include "Board.h"
 
 #include <atomic>
@@ -12,10 +14,15 @@
 #include <memory>
 #include <vector>
 
-struct UCTData {
-    float policy{0.0f};
-    int vertex{Board::NO_VERTEX};
+class UCTNode;
+
+// Everything shared by the nodes of one search tree. The arena owns
+// all nodes and their children lists. The table is nullptr unless the
+// transpositions share the nodes.
+struct UCTTree {
     std::shared_ptr<SearchParameters> parameters{nullptr};
+    NodeArena arena;
+    std::unique_ptr<NodeTable<UCTNode>> table{nullptr};
 };
 
 struct NNOutput {
@@ -23,24 +30,44 @@ struct NNOutput {
     float final_score;
 
     std::array<float, NUM_INTERSECTIONS> ownership;
+
+    // The result proves the winner only, like the WLD solver. The score
+    // and the ownership are not backed up, so the nodes keep their means.
+    bool proof_only{false};
 };
 
 #define VIRTUAL_LOSS_COUNT (2)
 
 class UCTNode {
 public:
-    using UCTNodePointer = NodePointer<UCTNode, UCTData>;
-    UCTNode(std::shared_ptr<UCTData> data);
-    ~UCTNode();
+    // The game theoretic result of the node for one side.
+    enum class Proof : std::uint8_t {
+        NONE = 0,
+        WIN,
+        LOSS,
+        DRAW
+    };
+
+    UCTNode(UCTTree *tree, const int vertex, const float policy, const int depth);
 
     bool expend_children(Evaluation &evaluation,
                          GameState &state,
                          std::shared_ptr<NNOutput> &nn_output,
                          const float min_psa_ratio, const bool is_root = false);
 
+    // The two halves of expend_children for the batched evaluation. The
+    // node is acquired first, and is expanded after its position is
+    // evaluated.
+    bool acquire_expanding();
+    void expend_children(const Evaluation::NNeval &raw_netlist,
+                         Position &state,
+                         std::shared_ptr<NNOutput> &nn_output,
+                         const float min_psa_ratio);
+
     int get_vertex() const;
     float get_policy() const;
     int get_visits() const;
+    int get_depth() const;
 
     int get_color() const;
     float get_raw_evaluation(const int color) const;
@@ -48,17 +75,27 @@ public:
     float get_eval(const int color, bool use_virtual_loss = true) const;
     float get_final_score(const int color) const;
     int get_most_visits_move();
+    // The average ownership if the node accumulates it. Otherwise the
+    // raw network ownership.
     std::array<float, NUM_INTERSECTIONS> get_ownership(const int color) const;
-    const std::vector<std::shared_ptr<UCTNodePointer>>& get_children() const;
+    const NodeList<UCTNode> &get_children() const;
     std::vector<std::pair<float, int>> get_lcb_list(const int color);
     std::vector<std::pair<float, int>> get_winrate_list(const int color);
 
     int get_best_move();
     int randomize_first_proportionally(float random_temp);
     UCTNode *get_child(const int vtx);
+    // Return nullptr if the node has no inflated child at the vertex.
+    UCTNode *find_child(const int vtx) const;
     UCTNode *get_most_visits_child();
     UCTNode *get();
-    UCTNode *uct_select_child(const int color, bool is_root);
+    // Return the index of the selected child.
+    size_t uct_select_child(const int color, bool is_root);
+    // Create the child at the index if it is not created. The state is the
+    // position after the move of the child. If the transpositions are
+    // shared, the child is linked to the node of the same position.
+    UCTNode *link_child(const size_t idx, const GameState &state);
+    void update_edge(const size_t idx);
 
     void increment_threads();
     void decrement_threads();
@@ -80,61 +117,121 @@ public:
     void set_active(const bool active);
     void invalinode();
     void update(std::shared_ptr<NNOutput> nn_output);
-    void accumulate_eval(float eval);
     bool prune_child(const int vtx);
 
+    // The terminal or solved result. It proves the node.
     void from_nn_output(std::shared_ptr<NNOutput> nn_output);
 
+    bool is_proven() const;
+    // The proof has no score. It is from the WLD solver.
+    bool is_proof_only() const;
+    Proof get_proof(const int color) const;
+    // The score is exact if all moves of the node are proven. If the node
+    // is won by one move, it is the score of the best proven move.
+    float get_proven_score(const int color) const;
+    // Prove the node from its children. It is won if any move is proven to
+    // win, and lost or drawn if all moves are proven.
+    void update_proof();
+    // The move of the best proven child. It is NO_VERTEX if the node is
+    // not proven, or is proven without any proven child.
+    int get_proven_move() const;
+
+    // Copy the node and its inflated subtree into the tree. The node is
+    // at the depth of the new tree, and the state is its position. No
+    // thread may search the node.
+    UCTNode *copy_subtree(UCTTree *tree, const int depth, GameState &state) const;
+
+    // The moves equivalent to the vertex under the symmetries which keep
+    // the position, the vertex included. They are folded into one child
+    // near the root.
+    static std::vector<int> get_symmetric_moves(const Position &state, const int vertex);
+
 private:
-    std::vector<std::shared_ptr<UCTNodePointer>> m_children;
-    std::shared_ptr<UCTData> m_data;
-    std::shared_ptr<SearchParameters> parameters() const;
+    const SearchParameters *parameters() const;
     enum Status : std::uint8_t { 
         INVALID, 
         PRUNED,
         ACTIVE
     };
-    std::atomic<Status> m_status{ACTIVE};  
 
+    enum class ExpandState : std::uint8_t { 
+        INITIAL = 0,
+        EXPANDING, 
+        EXPANDED
+    };
+
+    // The read-mostly data. They are written when the node is created or
+    // expanded.
+    NodeList<UCTNode> m_children;
+    UCTTree *m_tree;
+    int m_vertex;
+    float m_policy;
     int m_color{Board::INVAL};
     // Network raw output
     float m_raw_black_eval{0};
     float m_raw_black_final_score{0.0f};
-    std::array<float, NUM_INTERSECTIONS> m_raw_black_ownership;
-
-    // Network accumulated output
-    std::atomic<int> m_visits{0};
-    std::atomic<float> m_squared_eval_diff{1e-4f};
-    std::atomic<float> m_accumulated_black_evals{0.0f};
-    std::atomic<float> m_accumulated_black_finalscore{0.0f};
-    std::atomic<int> m_loading_threads{0};
-    std::array<float, NUM_INTERSECTIONS> m_accumulated_black_ownership;
+    std::uint16_t m_depth;
     std::atomic<bool> m_terminal{false};
+    // Some moves are cut by the policy, so the node can't be proven lost.
+    bool m_partial_children{false};
+    // The raw ownership in fixed point. 1.0 is stored as OWNERSHIP_SCALE.
+    std::array<std::int16_t, NUM_INTERSECTIONS> m_raw_black_ownership;
+
+    // The hot data. Every thread passing through the node writes them, and
+    // the parent reads them in the selection. They sit on their own cache
+    // line, so writing them never invalidates the read-mostly data.
+    //
+    // Network accumulated output. The sums are in fixed point, so the
+    // backup is a few fetch_add without any retry loop. The visits are
+    // added after the sums and are loaded before them.
+    alignas(64) std::atomic<int> m_visits{0};
+    std::atomic<int> m_loading_threads{0};
+    std::atomic<std::int64_t> m_accumulated_black_evals{0};
+    std::atomic<std::int64_t> m_accumulated_squared_evals{0};
+    std::atomic<std::int64_t> m_accumulated_black_finalscore{0};
+    std::atomic<ExpandState> m_expand_state{ExpandState::INITIAL};
+    std::atomic<Status> m_status{ACTIVE};
+    // The proof is for black. The score is stored before it.
+    std::atomic<Proof> m_black_proof{Proof::NONE};
+    std::atomic<bool> m_proof_only{false};
+    std::atomic<float> m_proven_black_score{0.0f};
+    // Only the nodes above the ownership depth accumulate the ownership.
+    // The sums are in fixed point like the others, so the threads add to
+    // them without any lock. It is nullptr for the other nodes.
+    std::atomic<std::int64_t> *m_accumulated_black_ownership{nullptr};
+
+    static constexpr float OWNERSHIP_SCALE = 32767.0f;
+
+    // 1.0 is stored as the scale. The sums don't overflow before 2^31
+    // visits. The ownership sums use the eval scale.
+    static constexpr double EVAL_SCALE = 16777216.0;
+    static constexpr double SCORE_SCALE = 65536.0;
+
+    static std::int64_t to_fixed(const double value, const double scale);
+    void accumulate_ownership(const std::array<float, NUM_INTERSECTIONS> &ownership);
+
+    UCTNode *inflate_child(const size_t idx);
+    void set_proof(const int color, const Proof proof,
+                   const float score, const bool proof_only);
+    // Return the size of the children if no child is proven.
+    size_t get_best_proven_child(const int color) const;
+    void set_raw_ownership(const std::array<float, NUM_INTERSECTIONS> &ownership);
 
     void link_nodelist(std::vector<Network::PolicyVertexPair> &nodelist, float min_psa_ratio);
+    // Keep one move of each class of the symmetric moves. Its policy is
+    // the sum of the class.
+    static void fold_symmetric_moves(const Position &state,
+                                     std::vector<Network::PolicyVertexPair> &nodelist);
     int get_threads() const;
     float get_eval_variance(float default_var) const;
     float get_eval_lcb(const int color) const;
     float get_mean_score(const int color) const;
     float get_score_utility(const int color, const float blance_score) const;
     void dirichlet_noise(float epsilon, float alpha);
-    void link_nn_output(GameState &state,
+    void link_nn_output(Position &state,
                         const Evaluation::NNeval &raw_netlist,
                         std::shared_ptr<NNOutput> &nn_output, const int color);
 
-    enum class ExpandState : std::uint8_t { 
-        INITIAL = 0,
-        EXPANDING, 
-        EXPANDED,
-        UPDATE
-    };
-    std::atomic<ExpandState> m_expand_state{ExpandState::INITIAL};
-
-    bool acquire_update();
-    bool wait_update();
-    void update_done();
-    bool acquire_expanding();
-
     // EXPANDING -> DONE
     void expand_done();
 
@@ -1,6 +1,7 @@
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <algorithm>
 #include <stdexcept>
@@ -140,6 +141,83 @@ float cached_t_quantile(int v) {
     return z_lookup[z_entries - 1];
 }
 
+std::uint16_t float_to_half(const float f) {
+
+    auto bits = std::uint32_t{0};
+    std::memcpy(&bits, &f, sizeof(bits));
+
+    const auto sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000);
+    const auto raw_exponent = static_cast<int>((bits >> 23) & 0xff);
+    const auto exponent = raw_exponent - 127 + 15;
+    auto mantissa = bits & 0x7fffff;
+
+    if (raw_exponent == 0xff) {
+        // Inf or NaN
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    if (exponent >= 0x1f) {
+        // Too large, round to Inf.
+        return sign | 0x7c00;
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            // Too small, round to zero.
+            return sign;
+        }
+        // Subnormal half
+        mantissa |= 0x800000;
+        const auto shift = 14 - exponent;
+        auto half = mantissa >> shift;
+        const auto rest = mantissa & ((1u << shift) - 1);
+        const auto halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            ++half;
+        }
+        return sign | static_cast<std::uint16_t>(half);
+    }
+
+    auto half = (static_cast<std::uint32_t>(exponent) << 10) | (mantissa >> 13);
+    const auto rest = mantissa & 0x1fff;
+
+    // Round to nearest even. The carry may go into the exponent,
+    // which is still correct.
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        ++half;
+    }
+    return sign | static_cast<std::uint16_t>(half);
+}
+
+float half_to_float(const std::uint16_t h) {
+
+    const auto sign = static_cast<std::uint32_t>(h & 0x8000) << 16;
+    const auto exponent = static_cast<std::uint32_t>((h >> 10) & 0x1f);
+    auto mantissa = static_cast<std::uint32_t>(h & 0x3ff);
+    auto bits = std::uint32_t{0};
+
+    if (exponent == 0x1f) {
+        // Inf or NaN
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // Subnormal half, normalize it.
+            auto e = std::uint32_t{0};
+            while ((mantissa & 0x400) == 0) {
+                mantissa <<= 1;
+                ++e;
+            }
+            bits = sign | ((127 - 14 - e) << 23) | ((mantissa & 0x3ff) << 13);
+        }
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    auto f = 0.0f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
 void auto_printf(const char *fmt, ...) {
 
     if (option<bool>("quiet")) {
@@ -12,6 +12,7 @@
 #include <string>
 #include <memory>
 #include <chrono>
+#include <cstdint>
 
 
 namespace Utils {
@@ -47,6 +48,11 @@ void atomic_add(std::atomic<T> &f, T d) {
     while (!f.compare_exchange_weak(old, old + d)) {}
 }
 
+// Convert between float and IEEE 754 half precision float.
+std::uint16_t float_to_half(const float f);
+
+float half_to_float(const std::uint16_t h);
+
 /**
  * Transform the string to words, and store one by one.
  */
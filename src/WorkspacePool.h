@@ -0,0 +1,49 @@
+#ifndef WORKSPACEPOOL_H_INCLUDE
+#define WORKSPACEPOOL_H_INCLUDE
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+ * The free list of the buffers of the forward. Each forward takes one
+ * workspace and puts it back when it is done. A new one is created only
+ * if more threads forward at once than ever before, so the steady forward
+ * allocates nothing.
+ */
+template<typename Workspace>
+class WorkspacePool {
+public:
+    WorkspacePool() = default;
+
+    WorkspacePool(const WorkspacePool&) = delete;
+    WorkspacePool& operator=(const WorkspacePool&) = delete;
+
+    std::unique_ptr<Workspace> acquire() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_free.empty()) {
+                auto workspace = std::move(m_free.back());
+                m_free.pop_back();
+                return workspace;
+            }
+        }
+        return std::make_unique<Workspace>();
+    }
+
+    void release(std::unique_ptr<Workspace> workspace) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.emplace_back(std::move(workspace));
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.clear();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Workspace>> m_free;
+};
+
+#endif
@@ -72,10 +72,12 @@ void init_options_map() {
     // network default parameters
     options_map["weights_file"] << Utils::Option::setoption(std::string{"_NO_FILE_"});
     options_map["softmax_temp"] << Utils::Option::setoption(1.0f);
-    options_map["cache_moves"] << Utils::Option::setoption(25);
+    options_map["cache_memory_mb"] << Utils::Option::setoption(100, MARCO_MAXIMAL_CACHE_MEMORY_MB,
+                                                           MARCO_MINIMAL_CACHE_MEMORY_MB);
     // options_map["mutil_labeled_komi"] << Utils::Option::setoption(0, 10, -10);
     options_map["batchsize"] << Utils::Option::setoption(1, 32, 1);
     options_map["waittime"] << Utils::Option::setoption(10);
+    options_map["evaluator_threads"] << Utils::Option::setoption(1, 16, 1);
 
     // uct search
     options_map["resigned_threshold"] << Utils::Option::setoption(0.1f, 1, 0);
@@ -89,8 +91,15 @@ void init_options_map() {
     options_map["puct"] << Utils::Option::setoption(0.5f);
     options_map["score_utility_div"] << Utils::Option::setoption(3.5f);
     options_map["ponder"] << Utils::Option::setoption(false);
+    options_map["reuse_tree"] << Utils::Option::setoption(true);
+    options_map["transposition"] << Utils::Option::setoption(false);
     options_map["random_min_visits"] << Utils::Option::setoption(1);
     options_map["endgame_search"] << Utils::Option::setoption(0, 32, 0);
+    options_map["endgame_wld_search"] << Utils::Option::setoption(0, 32, 0);
+    options_map["endgame_threads"] << Utils::Option::setoption(1, 64, 0);
+    options_map["ownership_depth"] << Utils::Option::setoption(2);
+    options_map["symmetry_depth"] << Utils::Option::setoption(2);
+    options_map["leaf_batch"] << Utils::Option::setoption(1, 256, 1);
 
     // time control paramters
     options_map["maintime"] << Utils::Option::setoption(3600);
@@ -169,6 +178,24 @@ ArgsParser::ArgsParser(int argc, char** argv) {
         }
     }
 
+    if (const auto res = parser.find_next("--waittime")) {
+        if (is_parameter(res->str)) {
+            set_option("waittime", res->get<int>());
+        }
+    }
+
+    if (const auto res = parser.find_next("--evaluator_threads")) {
+        if (is_parameter(res->str)) {
+            set_option("evaluator_threads", res->get<int>());
+        }
+    }
+
+    if (const auto res = parser.find_next("--cache_memory_mb")) {
+        if (is_parameter(res->str)) {
+            set_option("cache_memory_mb", res->get<int>());
+        }
+    }
+
     if (const auto res = parser.find_next("--komi")) {
         if (is_parameter(res->str)) {
             set_option("komi", res->get<float>());
@@ -191,12 +218,50 @@ ArgsParser::ArgsParser(int argc, char** argv) {
         }
     }
 
+    if (const auto res = parser.find_next("--endgame_wld_move")) {
+        if (is_parameter(res->str)) {
+            set_option("endgame_wld_search", res->get<int>());
+        }
+    }
+
+    if (const auto res = parser.find_next("--endgame_threads")) {
+        if (is_parameter(res->str)) {
+            set_option("endgame_threads", res->get<int>());
+        }
+    }
+
+    if (const auto res = parser.find_next("--ownership_depth")) {
+        if (is_parameter(res->str)) {
+            set_option("ownership_depth", res->get<int>());
+        }
+    }
+
+    if (const auto res = parser.find_next("--leaf_batch")) {
+        if (is_parameter(res->str)) {
+            set_option("leaf_batch", res->get<int>());
+        }
+    }
+
+    if (const auto res = parser.find_next("--symmetry_depth")) {
+        if (is_parameter(res->str)) {
+            set_option("symmetry_depth", res->get<int>());
+        }
+    }
+
     if (const auto res = parser.find_next("--resigned")) {
         if (is_parameter(res->str)) {
             set_option("resigned_threshold", res->get<float>());
         }
     }
 
+    if (const auto res = parser.find("--noreuse")) {
+        set_option("reuse_tree", false);
+    }
+
+    if (const auto res = parser.find("--transposition")) {
+        set_option("transposition", true);
+    }
+
     if (const auto res = parser.find("--collect")) {
         set_option("collect", true);
     }
@@ -221,6 +286,22 @@ void ArgsParser::help() const {
     Utils::auto_printf(" --komi <float>\n");
     Utils::auto_printf(" --boardsize <integral>\n");
     Utils::auto_printf(" --batchsize, -b <integral>\n");
+    Utils::auto_printf(" --waittime <integral>\n");
+    Utils::auto_printf(" --evaluator_threads <integral>\n");
+    Utils::auto_printf(" --leaf_batch <integral>\n");
+    Utils::auto_printf(" --endgame_move <integral>\n");
+    Utils::auto_printf(" --endgame_wld_move <integral>\n");
+    Utils::auto_printf(" --endgame_threads <integral>\n");
+    Utils::auto_printf(" --ownership_depth <integral>\n");
+    Utils::auto_printf(" --symmetry_depth <integral>\n");
+    Utils::auto_printf(" --cache_memory_mb <integral>\n");
+    Utils::auto_printf(" --transposition\n");
+    Utils::auto_printf(" --noreuse\n");
+    Utils::auto_printf(" --resigned <float>\n");
+    Utils::auto_printf(" --noise\n");
+    Utils::auto_printf(" --random\n");
+    Utils::auto_printf(" --random_div <integral>\n");
+    Utils::auto_printf(" --collect\n");
 }
 
 void ArgsParser::dump() const {
@@ -16,6 +16,10 @@
 #define MARCO_MINIMAL_KOMI (-150.f)
 #define MARCO_KOMI (0.0f)
 
+// The memory of the NN cache in MB.
+#define MARCO_MAXIMAL_CACHE_MEMORY_MB (16384)
+#define MARCO_MINIMAL_CACHE_MEMORY_MB (1)
+
 static_assert(MARCO_MAXIMAL_GTP_BOARD_SIZE >= MARCO_BOARD_SIZE &&
                   MARCO_BOARD_SIZE >= MARCO_MINIMAL_GTP_BOARD_SIZE, "Not support for this board size!\n");
 